@@ -0,0 +1,209 @@
+#include "acquisitionthread.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <errno.h>
+#include <poll.h>
+
+// longest time run() sleeps without looking at the control state
+#define	POLL_SLICE_MS	100
+
+AcquisitionThread::AcquisitionThread(int fd, QObject *parent) :
+    QThread(parent),
+    m_fd(fd),
+    m_mode(Idle),
+    m_intervalMs(0),
+    m_generation(0),
+    m_quit(false),
+    m_dropped(0),
+    m_capture(0)
+{
+    m_scale.range = NI4050_RANGE_INVALID;
+}
+
+AcquisitionThread::~AcquisitionThread()
+{
+    stop();
+}
+
+void AcquisitionThread::readOnce()
+{
+    setMode(Single);
+}
+
+void AcquisitionThread::startReading(int intervalMs)
+{
+    setMode(Continuous, intervalMs);
+}
+
+void AcquisitionThread::stopReading()
+{
+    setMode(Idle);
+}
+
+void AcquisitionThread::stop()
+{
+    m_lock.lock();
+    m_quit = true;
+    m_wake.wakeAll();
+    m_lock.unlock();
+
+    wait();
+}
+
+void AcquisitionThread::startCapture(CaptureWriter *writer)
+{
+    QMutexLocker locker(&m_captureLock);
+
+    m_capture = writer;
+}
+
+CaptureWriter *AcquisitionThread::stopCapture()
+{
+    QMutexLocker locker(&m_captureLock);
+    CaptureWriter *writer = m_capture;
+
+    m_capture = 0;
+    return writer;
+}
+
+void AcquisitionThread::capture(const NI4050Sample &sample)
+{
+    QMutexLocker locker(&m_captureLock);
+
+    if (m_capture && !m_capture->append(sample)) {
+        int error = errno;
+        qWarning() << "capture stopped after" << m_capture->count() << "records" << error;
+        // the GUI takes the writer back with stopCapture()
+        m_capture = 0;
+        emit captureFailed(error);
+    }
+}
+
+void AcquisitionThread::setMode(Mode mode, int intervalMs)
+{
+    QMutexLocker locker(&m_lock);
+
+    m_mode = mode;
+    m_intervalMs = intervalMs;
+    m_generation++;
+    m_wake.wakeAll();
+}
+
+// poll() for a conversion, false on timeout
+bool AcquisitionThread::waitForData(int timeoutMs)
+{
+    struct pollfd pfd;
+
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (::poll(&pfd, 1, timeoutMs) <= 0)
+        return false;
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        errno = ENODEV;
+        return false;
+    }
+    return true;
+}
+
+// Take the latched conversion, false with errno set if there is none
+bool AcquisitionThread::read(Reading *reading, NI4050Sample *raw)
+{
+    NI4050Sample &sample = *raw;
+    NI4050SampleBatch batch;
+
+    batch.samples = (quintptr)&sample;
+    batch.count = 1;
+    batch.flags = 0;
+    if (ioctl(m_fd, NIDMM_IOCREADSAMPLES, &batch) == -1)
+        return false;
+    if (batch.count != 1) {
+        errno = EAGAIN;
+        return false;
+    }
+
+    // the driver may have autoranged since the last sample
+    if (sample.range != m_scale.range) {
+        m_scale.range = sample.range;
+        if (ioctl(m_fd, NIDMM_IOCGETSCALE, &m_scale) == -1) {
+            m_scale.range = NI4050_RANGE_INVALID;
+            return false;
+        }
+    }
+
+    reading->value = ni4050ConvertRaw(&m_scale, sample.value);
+    reading->timestamp = sample.timestamp;
+    reading->range = (NI4050_RANGES)sample.range;
+    return true;
+}
+
+void AcquisitionThread::run()
+{
+    QElapsedTimer clock;
+    qint64 deadline = 0;
+    unsigned int generation = 0;
+
+    clock.start();
+    forever {
+        m_lock.lock();
+        while (!m_quit && m_mode == Idle)
+            m_wake.wait(&m_lock);
+        if (m_quit) {
+            m_lock.unlock();
+            break;
+        }
+        Mode mode = m_mode;
+        int intervalMs = m_intervalMs;
+        if (generation != m_generation) {
+            // a new request starts its cadence now
+            generation = m_generation;
+            deadline = clock.elapsed();
+        }
+        m_lock.unlock();
+
+        // the interval counts from deadline to deadline, not from the
+        // end of the last read, so the cadence does not drift
+        qint64 early = deadline - clock.elapsed();
+        if (early > 0) {
+            msleep(qMin<qint64>(early, POLL_SLICE_MS));
+            continue;
+        }
+
+        errno = 0;
+        if (!waitForData(POLL_SLICE_MS)) {
+            if (errno == 0 || errno == EINTR)
+                continue;
+        } else {
+            Reading reading;
+            NI4050Sample sample;
+            if (read(&reading, &sample)) {
+                capture(sample);
+                if (!m_queue.push(reading))
+                    m_dropped.fetchAndAddRelaxed(1);
+
+                m_lock.lock();
+                if (generation == m_generation) {
+                    if (mode == Single)
+                        m_mode = Idle;
+                    deadline += intervalMs;
+                    if (deadline < clock.elapsed() - intervalMs)
+                        deadline = clock.elapsed();	// fell behind, do not catch up in a burst
+                }
+                m_lock.unlock();
+                continue;
+            }
+            if (errno == EAGAIN)
+                continue;
+        }
+
+        int error = errno;
+        qWarning() << "reading the device failed" << error;
+        m_lock.lock();
+        if (generation == m_generation)
+            m_mode = Idle;
+        m_lock.unlock();
+        emit readFailed(error);
+    }
+}
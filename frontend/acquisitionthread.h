@@ -0,0 +1,97 @@
+#ifndef ACQUISITIONTHREAD_H
+#define ACQUISITIONTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+#include <sys/ioctl.h>
+
+#include "../module/ni4050.h"
+#include "../libnidmm/capturefile.h"
+#include "samplequeue.h"
+
+typedef struct Reading_t {
+    double value;
+    quint64 timestamp;	// ns, clock of the driver
+    NI4050_RANGES range;
+} Reading;
+
+// Reads the conversions of one open device off the GUI thread.
+//
+// The descriptor has to be opened with O_NONBLOCK: the thread waits in
+// poll() with a short timeout, so it neither holds the driver mutex while
+// the GUI reprograms the card nor misses a stop request. The readings go
+// to queue(), which the GUI drains on its own tick.
+class AcquisitionThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum {
+        QueueSize = 4096
+    };
+    typedef SampleQueue<Reading, QueueSize> Queue;
+
+    explicit AcquisitionThread(int fd, QObject *parent = 0);
+    ~AcquisitionThread();
+
+    // Take one reading, or one every intervalMs until stopReading(), 0 for
+    // every conversion
+    void readOnce();
+    void startReading(int intervalMs);
+    void stopReading();
+    // Leave run(), waits for the thread
+    void stop();
+
+    // Record every raw sample read from now on into writer, which has to be
+    // open. stopCapture() hands it back, the caller closes it.
+    void startCapture(CaptureWriter *writer);
+    CaptureWriter *stopCapture();
+
+    Queue &queue() { return m_queue; }
+    // readings lost because the GUI did not keep up
+    int dropped() const { return m_dropped; }
+
+signals:
+    // the read failed, errno in error; the thread went idle
+    void readFailed(int error);
+    // the capture file could not grow, errno in error; recording stopped
+    void captureFailed(int error);
+
+protected:
+    void run();
+
+private:
+    enum Mode {
+        Idle,
+        Single,
+        Continuous
+    };
+
+    void setMode(Mode mode, int intervalMs = 0);
+    bool waitForData(int timeoutMs);
+    bool read(Reading *reading, NI4050Sample *sample);
+    void capture(const NI4050Sample &sample);
+
+    int m_fd;
+    NI4050Scale m_scale;
+
+    // control state, not touched by the sample path
+    QMutex m_lock;
+    QWaitCondition m_wake;
+    Mode m_mode;
+    int m_intervalMs;
+    unsigned int m_generation;	// bumped by every request
+    bool m_quit;
+
+    Queue m_queue;
+    QAtomicInt m_dropped;
+
+    // held around every append, so the GUI only waits for one record
+    QMutex m_captureLock;
+    CaptureWriter *m_capture;
+};
+
+#endif // ACQUISITIONTHREAD_H
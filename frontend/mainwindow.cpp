@@ -4,11 +4,28 @@
 #include <QDebug>
 #include <QPen>
 #include <QDir>
+#include <QFile>
+#include <QFileDialog>
+#include <QMessageBox>
+
+#include <qwt/qwt_scale_map.h>
+
+#include <string.h>
+#include <time.h>
+
+// room left on the right of the time axis when it has to grow, so most
+// readings can be drawn incrementally
+#define	TIME_AXIS_HEADROOM	1.25
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    fd(-1)
+    fd(-1),
+    acquisition(0),
+    range(NI4050_RANGE_INVALID),
+    captureWriter(0),
+    firstTimestamp(0),
+    replotNeeded(true)
 {
     ui->setupUi(this);
 
@@ -17,80 +34,103 @@ MainWindow::MainWindow(QWidget *parent) :
 
     contRunning = false;
 
+    valueData = new RingSeriesData(ui->spinBoxHistory->value() * 1000);
     outCurve.setTitle("Output data");
-    outCurve.setSamples(valueData);
+    outCurve.setData(valueData);
     outCurve.attach(ui->qwtPlot);
     QPen pen;
     pen.setColor(Qt::green);
     pen.setWidth(2);
     outCurve.setPen(pen);
 
+    tailCurve.setPen(pen);
+    tailCurve.setItemAttribute(QwtPlotItem::AutoScale, false);
+    tailCurve.attach(ui->qwtPlot);
+    directPainter = new QwtPlotDirectPainter(this);
+
     ui->qwtPlot->setAxisAutoScale(0);
     ui->qwtPlot->setAxisAutoScale(1);
     ui->qwtPlot->setCanvasBackground(QBrush(Qt::black));
 
     ui->qwtPlot->setAxisTitle(1, tr("Time"));
+
+    timer.setInterval(1000 / ui->spinBoxPlotRate->value());
+    connect(&timer, SIGNAL(timeout()), this, SLOT(renderTick()));
 }
 
 MainWindow::~MainWindow()
 {
+    closeDevice();
+    delete ui;
+}
+
+void MainWindow::closeDevice()
+{
+    timer.stop();
+    stopCapture();
+    delete acquisition;
+    acquisition = 0;
     if (fd != -1) {
         ::close(fd);
+        fd = -1;
     }
-    delete ui;
+    contRunning = false;
 }
 
 void MainWindow::on_pushButtonOpen_clicked()
 {
     if (fd == -1) {
-        if ((fd = ::open(ui->comboBoxDevice->currentText().toAscii() ,O_RDWR)) != -1) {
+        // the acquisition thread waits in poll(), see AcquisitionThread
+        if ((fd = ::open(ui->comboBoxDevice->currentText().toAscii(), O_RDWR | O_NONBLOCK)) != -1) {
+            acquisition = new AcquisitionThread(fd, this);
+            connect(acquisition, SIGNAL(readFailed(int)), this, SLOT(readFailed(int)));
+            connect(acquisition, SIGNAL(captureFailed(int)), this, SLOT(captureFailed(int)));
+            acquisition->start();
+            timer.start();
             ui->pushButtonOpen->setText(tr("Close"));
             ui->pushButtonStartMeasurement->setEnabled(true);
+            ui->pushButtonRecord->setEnabled(true);
             return;
         } else {
             qWarning() << "failed to open" << fd;
-            ::close(fd);
-            fd = -1;
         }
     } else {
-        ::close(fd);
-        fd = -1;
+        closeDevice();
         ui->pushButtonOpen->setText(tr("Open"));
     }
     ui->pushButtonStartMeasurement->setEnabled(false);
+    ui->pushButtonReadValue->setEnabled(false);
+    ui->pushButtonRecord->setEnabled(false);
+    on_checkBoxReadContinously_toggled(ui->checkBoxReadContinously->isChecked());
 }
 
 void MainWindow::on_pushButtonReadValue_clicked()
 {
-    ui->doubleSpinBoxValue->setValue(0);
-    double value = 0;
+    if (!acquisition)
+        return;
 
-    if (fd != -1) {
-        if (ui->checkBoxReadContinously->isChecked()) {
-            contRunning = !contRunning;
-            if (contRunning) {
-                if (ioctl(fd, NIDMM_IOCREADDATA, &value) != -1) {
-                    ui->doubleSpinBoxValue->setValue(value);
-                    QTimer::singleShot(ui->doubleSpinBoxInterval->value()*1000, this, SLOT(timeOut()));
-                    ui->pushButtonReadValue->setText(tr("Stop reading"));
-                }
-            } else {
-                ui->pushButtonReadValue->setText(tr("Start reading"));
-            }
+    if (ui->checkBoxReadContinously->isChecked()) {
+        contRunning = !contRunning;
+        if (contRunning) {
+            acquisition->startReading(ui->doubleSpinBoxInterval->value()*1000);
+            ui->pushButtonReadValue->setText(tr("Stop reading"));
         } else {
-            if (ioctl(fd, NIDMM_IOCREADDATA, &value) != -1) {
-                ui->doubleSpinBoxValue->setValue(value);
-            }
+            acquisition->stopReading();
+            ui->pushButtonReadValue->setText(tr("Start reading"));
         }
+    } else {
+        ui->doubleSpinBoxValue->setValue(0);
+        acquisition->readOnce();
     }
 }
 
 void MainWindow::on_pushButtonStartMeasurement_clicked()
 {
-    NI4050_RANGES range = (NI4050_RANGES)ui->comboBoxMeasurementMode->itemData(ui->comboBoxMeasurementMode->currentIndex()).toInt();
+    NI4050_RANGES selected = (NI4050_RANGES)ui->comboBoxMeasurementMode->itemData(ui->comboBoxMeasurementMode->currentIndex()).toInt();
 
     if (fd != -1) {
-        if (ioctl(fd, NIDMM_IOCSTARTMEASUREMENT, &range) != -1) {
+        if (ioctl(fd, NIDMM_IOCSTARTMEASUREMENT, &selected) != -1) {
+            range = selected;
             ui->pushButtonReadValue->setEnabled(true);
         }
     }
@@ -119,6 +159,10 @@ void MainWindow::fillDeviceComboBox()
 
 void MainWindow::on_checkBoxReadContinously_toggled(bool checked)
 {
+    if (contRunning && acquisition) {
+        acquisition->stopReading();
+        contRunning = false;
+    }
     ui->doubleSpinBoxInterval->setEnabled(checked);
     if (checked) {
         ui->pushButtonReadValue->setText("Start reading");
@@ -132,34 +176,230 @@ void MainWindow::on_comboBoxMeasurementMode_activated(const QString &arg1)
     Q_UNUSED(arg1)
 }
 
-void MainWindow::timeOut()
-{
-    double value = 0;
-    if (ui->checkBoxReadContinously->isChecked() && contRunning) {
-        if (fd != -1) {
-            if (ioctl(fd, NIDMM_IOCREADDATA, &value) != -1) {
-                ui->doubleSpinBoxValue->setValue(value);
-                QTimer::singleShot(ui->doubleSpinBoxInterval->value()*1000, this, SLOT(timeOut()));
-                if (ui->checkBoxPlotNeeded->isChecked()) {
-                    QPointF pt;
-                    double x = 0;
-                    if (valueData.size())
-                        x = valueData.last().x();
-                    pt.setX(x + ui->doubleSpinBoxInterval->value()*1000);
-                    pt.setY(value);
-                    valueData.append(pt);
-                    outCurve.setSamples(valueData);
-
-                    ui->qwtPlot->replot();
-                }
-            }
+// Take everything the acquisition thread queued since the last tick,
+// the widgets are updated once per tick however fast the readings come
+void MainWindow::renderTick()
+{
+    Reading reading;
+    bool any = false;
+    // a paused plot keeps collecting into valueData, resuming redraws it all
+    bool paused = ui->checkBoxPausePlot->isChecked();
+
+    if (!acquisition)
+        return;
+
+    while (acquisition->queue().pop(&reading)) {
+        any = true;
+        // single readings only show up in the value box
+        if (contRunning && ui->checkBoxPlotNeeded->isChecked()) {
+            // time axis in ms from the driver timestamp of the conversion
+            QPointF pt;
+            if (valueData->count() == 0)
+                firstTimestamp = reading.timestamp;
+            pt.setX((reading.timestamp - firstTimestamp) / 1e6);
+            pt.setY(reading.value);
+            valueData->append(pt);
+            if (!paused)
+                pendingPoints.append(pt);
         }
     }
+
+    if (any)
+        ui->doubleSpinBoxValue->setValue(reading.value);
+
+    if (!paused)
+        drawPlot();
+}
+
+// Bring the plot up to date with valueData
+void MainWindow::drawPlot()
+{
+    if (!replotNeeded && pendingPoints.isEmpty())
+        return;
+
+    if (replotNeeded || !fitsCanvas(pendingPoints)) {
+        updateTimeAxis();
+        valueData->setResolution(ui->qwtPlot->canvas()->width());
+        ui->qwtPlot->replot();
+        replotNeeded = false;
+    } else {
+        // connect to the end of what is on the canvas already
+        QVector<QPointF> tail;
+        if (valueData->count() > pendingPoints.size())
+            tail.append(lastDrawn);
+        tail += pendingPoints;
+        tailCurve.setSamples(tail);
+        directPainter->drawSeries(&tailCurve, 0, tail.size() - 1);
+        tailCurve.setSamples(QVector<QPointF>());
+    }
+
+    if (!pendingPoints.isEmpty())
+        lastDrawn = pendingPoints.last();
+    pendingPoints.clear();
+}
+
+bool MainWindow::fitsCanvas(const QVector<QPointF> &points) const
+{
+    const QwtScaleMap xMap = ui->qwtPlot->canvasMap(QwtPlot::xBottom);
+    const QwtScaleMap yMap = ui->qwtPlot->canvasMap(QwtPlot::yLeft);
+    double x1 = qMin(xMap.s1(), xMap.s2()), x2 = qMax(xMap.s1(), xMap.s2());
+    double y1 = qMin(yMap.s1(), yMap.s2()), y2 = qMax(yMap.s1(), yMap.s2());
+
+    foreach (const QPointF &pt, points) {
+        if (pt.x() < x1 || pt.x() > x2 || pt.y() < y1 || pt.y() > y2)
+            return false;
+    }
+    return true;
+}
+
+// The time axis only grows, by a step with headroom, when the readings
+// reach its end. The value axis scales itself.
+void MainWindow::updateTimeAxis()
+{
+    const QwtScaleMap xMap = ui->qwtPlot->canvasMap(QwtPlot::xBottom);
+    QRectF rect = valueData->boundingRect();
+
+    if (valueData->count() == 0) {
+        ui->qwtPlot->setAxisAutoScale(QwtPlot::xBottom);
+        return;
+    }
+
+    if (ui->qwtPlot->axisAutoScale(QwtPlot::xBottom) || qMax(xMap.s1(), xMap.s2()) < rect.right())
+        ui->qwtPlot->setAxisScale(QwtPlot::xBottom, rect.left(),
+                                  rect.left() + qMax(rect.width(), 1.0) * TIME_AXIS_HEADROOM);
+}
+
+void MainWindow::readFailed(int error)
+{
+    qWarning() << "reading stopped:" << strerror(error);
+    contRunning = false;
+    on_checkBoxReadContinously_toggled(ui->checkBoxReadContinously->isChecked());
 }
 
 void MainWindow::on_pushButtonClearPlot_clicked()
 {
-    valueData.clear();
-    outCurve.setSamples(valueData);
-    ui->qwtPlot->replot();
+    valueData->clear();
+    pendingPoints.clear();
+    replotNeeded = true;
+    drawPlot();
+}
+
+void MainWindow::on_spinBoxHistory_valueChanged(int thousands)
+{
+    valueData->setCapacity(thousands * 1000);
+    replotNeeded = true;
+    if (!ui->checkBoxPausePlot->isChecked())
+        drawPlot();
+}
+
+void MainWindow::on_spinBoxPlotRate_valueChanged(int fps)
+{
+    timer.setInterval(1000 / fps);
+}
+
+void MainWindow::on_checkBoxPausePlot_toggled(bool checked)
+{
+    // the points collected meanwhile are drawn in one go on resume
+    if (!checked) {
+        pendingPoints.clear();
+        replotNeeded = true;
+        drawPlot();
+    }
+}
+
+#define CAPTURE_EEPROM_ADDRESS(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+        acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    NI4050_EEPROM_AREA_LOAD + NI4050_EEPROM_OFFSET(eepromMode, eepromRange, calFilter),
+
+// Calibration words of the default filter of every range, the driver loads them from here
+static const unsigned int captureEepromAddresses[NI4050_RANGE_COUNT] = {
+    NI4050_RANGE_TABLE(CAPTURE_EEPROM_ADDRESS)
+};
+
+static uint32_t eepromWord(const unsigned char *eeprom, unsigned int address)
+{
+    return eeprom[address] | eeprom[address + 1] << 8 | eeprom[address + 2] << 16;
+}
+
+// Everything the capture needs to be converted without the card
+bool MainWindow::fillCaptureHeader(NI4050CaptureHeader *header)
+{
+    unsigned char eeprom[NI4050_EEPROM_SIZE];
+    NI4050EepromBlock block;
+    struct timespec now;
+
+    memset(header, 0, sizeof(*header));
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->startTime = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    // the frontend leaves the driver on its default clock and filters
+    header->clockId = CLOCK_MONOTONIC;
+    header->filterCode = 0;
+    header->startRange = range;
+    strncpy(header->device, ui->comboBoxDevice->currentText().toAscii(), sizeof(header->device) - 1);
+
+    if (ioctl(fd, NIDMM_IOCEEPROMREADINTRES, &header->intResistance) == -1)
+        return false;
+
+    // the driver's copy, one call instead of one per byte
+    block.address = 0;
+    block.length = sizeof(eeprom);
+    block.data = (uintptr_t)eeprom;
+    if (ioctl(fd, NIDMM_IOCEEPROMREADBLOCK, &block) == -1 || block.length != sizeof(eeprom))
+        return false;
+
+    for (int i = 0; i < NI4050_RANGE_COUNT; i++) {
+        header->scales[i].range = i;
+        if (ioctl(fd, NIDMM_IOCGETSCALE, &header->scales[i]) == -1)
+            return false;
+        header->calibration[i].zero = eepromWord(eeprom, captureEepromAddresses[i] + NI4050_EEPROM_CAL_ZERO);
+        header->calibration[i].full = eepromWord(eeprom, captureEepromAddresses[i] + NI4050_EEPROM_CAL_FULL);
+    }
+    return true;
+}
+
+void MainWindow::on_pushButtonRecord_clicked()
+{
+    NI4050CaptureHeader header;
+
+    if (captureWriter) {
+        stopCapture();
+        return;
+    }
+    if (!acquisition)
+        return;
+
+    QString path = QFileDialog::getSaveFileName(this, tr("Record to"), QString(), tr("Captures (*.nidmm)"));
+    if (path.isEmpty())
+        return;
+
+    captureWriter = new CaptureWriter;
+    if (!fillCaptureHeader(&header) || !captureWriter->open(QFile::encodeName(path), header)) {
+        QMessageBox::warning(this, tr("Record"), tr("Could not start recording: %1").arg(strerror(errno)));
+        delete captureWriter;
+        captureWriter = 0;
+        return;
+    }
+
+    acquisition->startCapture(captureWriter);
+    ui->pushButtonRecord->setText(tr("Stop recording"));
+}
+
+void MainWindow::stopCapture()
+{
+    if (!captureWriter)
+        return;
+
+    if (acquisition)
+        acquisition->stopCapture();
+    if (!captureWriter->close())
+        qWarning() << "closing the capture failed:" << strerror(errno);
+    delete captureWriter;
+    captureWriter = 0;
+    ui->pushButtonRecord->setText(tr("Record..."));
+}
+
+void MainWindow::captureFailed(int error)
+{
+    QMessageBox::warning(this, tr("Record"), tr("Recording stopped: %1").arg(strerror(error)));
+    stopCapture();
 }
@@ -6,6 +6,7 @@
 
 #include <qwt/qwt.h>
 #include <qwt/qwt_plot_curve.h>
+#include <qwt/qwt_plot_directpainter.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +15,8 @@
 #include <sys/ioctl.h>		/* ioctl */
 
 #include "../module/ni4050.h"
+#include "acquisitionthread.h"
+#include "ringseriesdata.h"
 
 typedef struct MeasurementMode_t {
     QString name;
@@ -22,24 +25,12 @@ typedef struct MeasurementMode_t {
     NI4050_RANGES range;
 } MeasurementMode;
 
+#define MEASUREMENT_MODE(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+        acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    {label, unit, title, NI4050_RANGE_##range},
+
 const MeasurementMode measurementModes[] = {
-    {"250VDC", "V", "Voltage", NI4050_RANGE_250VDC},
-    {"25VDC", "V", "Voltage", NI4050_RANGE_25VDC},
-    {"2VDC", "V", "Voltage",NI4050_RANGE_2VDC},
-    {"200mVDC", "mV", "Voltage",NI4050_RANGE_200mVDC},
-    {"20mVDC", "mV", "Voltage",NI4050_RANGE_20mVDC},
-    {"250VAC", "V", "Voltage",NI4050_RANGE_250VAC},
-    {"25VAC", "V", "Voltage",NI4050_RANGE_25VAC},
-    {"2VAC", "V", "Voltage",NI4050_RANGE_2VAC},
-    {"200mVAC", "mV", "Voltage",NI4050_RANGE_200mVAC},
-    {"20mVAC", "mV", "Voltage",NI4050_RANGE_20mVAC},
-    {"EXTOHM",  "Ohm//FIXME", "Resistance",NI4050_RANGE_EXTOHM},
-    {"2MOHM", "MOhm", "Resistance",NI4050_RANGE_2MOHM},
-    {"200kOHM", "KOhm", "Resistance",NI4050_RANGE_200kOHM},
-    {"20kOHM", "KOhm", "Resistance",NI4050_RANGE_20kOHM},
-    {"2kOHM", "KOhm", "Resistance",NI4050_RANGE_2kOHM},
-    {"200OHM", "Ohm", "Resistance",NI4050_RANGE_200OHM},
-    {"DIODE", "V", "Foward voltage",NI4050_RANGE_DIODE},
+    NI4050_RANGE_TABLE(MEASUREMENT_MODE)
     {"INVALID", "", "", NI4050_RANGE_INVALID}
 };
 
@@ -65,21 +56,50 @@ private slots:
     void on_checkBoxReadContinously_toggled(bool checked);
     void on_comboBoxMeasurementMode_activated(const QString &arg1);
 
-    void timeOut();
+    void renderTick();
+    void readFailed(int error);
 
     void on_pushButtonClearPlot_clicked();
+    void on_spinBoxHistory_valueChanged(int thousands);
+    void on_spinBoxPlotRate_valueChanged(int fps);
+    void on_checkBoxPausePlot_toggled(bool checked);
+    void on_pushButtonRecord_clicked();
+    void captureFailed(int error);
 
 private:
     Ui::MainWindow *ui;
     int fd;
     void fillRangeCombobox();
     void fillDeviceComboBox();
-
+    void closeDevice();
+    bool fillCaptureHeader(NI4050CaptureHeader *header);
+    void stopCapture();
+    void drawPlot();
+    bool fitsCanvas(const QVector<QPointF> &points) const;
+    void updateTimeAxis();
+
+    // reads the open device, the GUI thread never blocks on it
+    AcquisitionThread *acquisition;
+    // drains the acquisition queue into the widgets, spinBoxPlotRate times a second
     QTimer timer;
     bool contRunning;
+    // range of the last NIDMM_IOCSTARTMEASUREMENT
+    NI4050_RANGES range;
+
+    // capture file the acquisition thread records into, 0 if none
+    CaptureWriter *captureWriter;
 
     QwtPlotCurve outCurve;
-    QVector <QPointF> valueData;
+    RingSeriesData *valueData;	// owned by outCurve
+    quint64 firstTimestamp;
+
+    // points not drawn yet, painted onto the canvas as a tail of the curve
+    // while they fit the axes, otherwise the whole plot is redrawn
+    QVector<QPointF> pendingPoints;
+    QPointF lastDrawn;
+    bool replotNeeded;
+    QwtPlotCurve tailCurve;
+    QwtPlotDirectPainter *directPainter;
 };
 
 #endif // MAINWINDOW_H
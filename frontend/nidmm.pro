@@ -20,10 +20,16 @@ DESTDIR=bin
 
 
 SOURCES += main.cpp\
-        mainwindow.cpp
-
-HEADERS  += mainwindow.h
+        mainwindow.cpp \
+        acquisitionthread.cpp \
+        ringseriesdata.cpp
+
+HEADERS  += mainwindow.h \
+        acquisitionthread.h \
+        samplequeue.h \
+        ringseriesdata.h
 FORMS    += mainwindow.ui
 
-LIBS += -lqwt
+LIBS += -lqwt -L../libnidmm/lib -lnidmm
+PRE_TARGETDEPS += ../libnidmm/lib/libnidmm.a
 
@@ -0,0 +1,184 @@
+#include "ringseriesdata.h"
+
+#include <float.h>
+
+RingSeriesData::RingSeriesData(int capacity) :
+    m_capacity(qMax(capacity, 1)),
+    m_first(0),
+    m_count(0),
+    m_pixels(1000),
+    m_minY(0),
+    m_maxY(0),
+    m_rangeValid(true),
+    m_dirty(true)
+{
+}
+
+void RingSeriesData::setCapacity(int capacity)
+{
+    QVector<QPointF> points;
+    int keep;
+
+    capacity = qMax(capacity, 1);
+    if (capacity == m_capacity)
+        return;
+
+    // keep the newest points, in order from index 0 on
+    keep = qMin(m_count, capacity);
+    points.reserve(keep);
+    for (int i = m_count - keep; i < m_count; i++)
+        points.append(at(i));
+
+    m_points = points;
+    m_capacity = capacity;
+    m_first = 0;
+    m_count = keep;
+    m_rangeValid = false;
+    m_dirty = true;
+}
+
+void RingSeriesData::append(const QPointF &point)
+{
+    if (m_count == 0 && m_rangeValid) {
+        m_minY = m_maxY = point.y();
+    } else if (m_rangeValid) {
+        m_minY = qMin(m_minY, point.y());
+        m_maxY = qMax(m_maxY, point.y());
+    }
+
+    if (m_points.size() < m_capacity) {
+        m_points.append(point);
+        m_count++;
+    } else {
+        const QPointF &old = m_points[m_first];
+        // the range has to be searched again only if an extreme goes
+        if (old.y() <= m_minY || old.y() >= m_maxY)
+            m_rangeValid = false;
+        m_points[m_first] = point;
+        m_first = (m_first + 1) % m_capacity;
+    }
+
+    m_dirty = true;
+}
+
+void RingSeriesData::clear()
+{
+    m_points.clear();
+    m_first = 0;
+    m_count = 0;
+    m_rangeValid = true;
+    m_dirty = true;
+}
+
+void RingSeriesData::setResolution(int pixels)
+{
+    pixels = qMax(pixels, 1);
+    if (pixels != m_pixels) {
+        m_pixels = pixels;
+        m_dirty = true;
+    }
+}
+
+void RingSeriesData::setRectOfInterest(const QRectF &rect)
+{
+    if (rect != m_interest) {
+        m_interest = rect;
+        m_dirty = true;
+    }
+}
+
+size_t RingSeriesData::size() const
+{
+    if (m_dirty)
+        decimate();
+    return m_decimated.size();
+}
+
+QPointF RingSeriesData::sample(size_t i) const
+{
+    if (m_dirty)
+        decimate();
+    return m_decimated[i];
+}
+
+QRectF RingSeriesData::boundingRect() const
+{
+    if (m_count == 0)
+        return QRectF(1.0, 1.0, -2.0, -2.0);	// invalid, like an empty QwtPointSeriesData
+
+    if (!m_rangeValid) {
+        m_minY = m_maxY = at(0).y();
+        for (int i = 1; i < m_count; i++) {
+            m_minY = qMin(m_minY, at(i).y());
+            m_maxY = qMax(m_maxY, at(i).y());
+        }
+        m_rangeValid = true;
+    }
+
+    // x increases, so the ends of the ring bound it
+    return QRectF(at(0).x(), m_minY, at(m_count - 1).x() - at(0).x(), m_maxY - m_minY);
+}
+
+// First point with x >= the given one
+int RingSeriesData::lowerBound(qreal x) const
+{
+    int lo = 0, hi = m_count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (at(mid).x() < x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Reduce the visible points to the minimum and maximum of every pixel column,
+// in the order they were taken so the curve keeps its shape
+void RingSeriesData::decimate() const
+{
+    int begin = 0, end = m_count;
+    qreal x0, width;
+
+    m_dirty = false;
+    m_decimated.resize(0);
+    if (m_count == 0)
+        return;
+
+    // one point beyond each edge so the lines leave the canvas
+    if (m_interest.isValid() && m_interest.width() > 0) {
+        begin = qMax(lowerBound(m_interest.left()) - 1, 0);
+        end = qMin(lowerBound(m_interest.right()) + 1, m_count);
+    }
+
+    if (end - begin <= 2 * m_pixels) {
+        m_decimated.reserve(end - begin);
+        for (int i = begin; i < end; i++)
+            m_decimated.append(at(i));
+        return;
+    }
+
+    x0 = at(begin).x();
+    width = (at(end - 1).x() - x0) / m_pixels;
+    if (width <= 0)
+        width = DBL_MIN;
+
+    m_decimated.reserve(2 * m_pixels + 2);
+    int i = begin;
+    while (i < end) {
+        int column = (at(i).x() - x0) / width;
+        int min = i, max = i;
+
+        for (i++; i < end && (int)((at(i).x() - x0) / width) == column; i++) {
+            if (at(i).y() < at(min).y())
+                min = i;
+            if (at(i).y() > at(max).y())
+                max = i;
+        }
+
+        m_decimated.append(at(qMin(min, max)));
+        if (min != max)
+            m_decimated.append(at(qMax(min, max)));
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef RINGSERIESDATA_H
+#define RINGSERIESDATA_H
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+
+#include <qwt/qwt_series_data.h>
+
+// Plot history of at most capacity() points, the oldest ones are dropped.
+//
+// The curve does not get the points themselves: for every pixel column of
+// the visible x range only the minimum and the maximum are handed out, so
+// drawing costs the same for a minute and for a night of readings. The x
+// values have to be appended in increasing order.
+class RingSeriesData : public QwtSeriesData<QPointF>
+{
+public:
+    explicit RingSeriesData(int capacity);
+
+    // Memory is allocated as the points come, up to capacity * sizeof(QPointF)
+    void setCapacity(int capacity);
+    int capacity() const { return m_capacity; }
+    // Points held, as opposed to size() which counts the decimated ones
+    int count() const { return m_count; }
+
+    void append(const QPointF &point);
+    void clear();
+
+    // Width of the plot canvas in pixels
+    void setResolution(int pixels);
+
+    virtual size_t size() const;
+    virtual QPointF sample(size_t i) const;
+    virtual QRectF boundingRect() const;
+    virtual void setRectOfInterest(const QRectF &rect);
+
+private:
+    const QPointF &at(int i) const { return m_points[(m_first + i) % m_points.size()]; }
+    int lowerBound(qreal x) const;
+    void decimate() const;
+
+    QVector<QPointF> m_points;
+    int m_capacity;
+    int m_first;	// index of the oldest point in m_points
+    int m_count;
+
+    int m_pixels;
+    QRectF m_interest;
+
+    // minimum and maximum of y, invalid once one of them was dropped
+    mutable qreal m_minY, m_maxY;
+    mutable bool m_rangeValid;
+
+    // what size() and sample() hand out, rebuilt when dirty
+    mutable QVector<QPointF> m_decimated;
+    mutable bool m_dirty;
+};
+
+#endif // RINGSERIESDATA_H
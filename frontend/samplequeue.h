@@ -0,0 +1,52 @@
+#ifndef SAMPLEQUEUE_H
+#define SAMPLEQUEUE_H
+
+#include <QAtomicInt>
+
+// Lock-free queue between exactly one producer and one consumer thread.
+//
+// head is only written by the producer and tail only by the consumer, each
+// side publishes its index with a release store after touching the slot and
+// reads the other one with an acquire load. The indices run freely and wrap,
+// Size has to be a power of 2.
+template <typename T, int Size>
+class SampleQueue
+{
+    typedef char SizeCheck[(Size > 0 && (Size & (Size - 1)) == 0) ? 1 : -1];
+
+public:
+    SampleQueue() : m_head(0), m_tail(0) {}
+
+    // Producer side, false if the queue is full
+    bool push(const T &item)
+    {
+        unsigned int head = m_head.fetchAndAddRelaxed(0);
+        unsigned int tail = m_tail.fetchAndAddAcquire(0);
+
+        if (head - tail == (unsigned int)Size)
+            return false;
+        m_items[head & (Size - 1)] = item;
+        m_head.fetchAndStoreRelease(head + 1);
+        return true;
+    }
+
+    // Consumer side, false if the queue is empty
+    bool pop(T *item)
+    {
+        unsigned int tail = m_tail.fetchAndAddRelaxed(0);
+        unsigned int head = m_head.fetchAndAddAcquire(0);
+
+        if (head == tail)
+            return false;
+        *item = m_items[tail & (Size - 1)];
+        m_tail.fetchAndStoreRelease(tail + 1);
+        return true;
+    }
+
+private:
+    QAtomicInt m_head;
+    QAtomicInt m_tail;
+    T m_items[Size];
+};
+
+#endif // SAMPLEQUEUE_H
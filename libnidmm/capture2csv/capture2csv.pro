@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Export a capture file as CSV in engineering units
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = capture2csv
+TEMPLATE = app
+CONFIG += console
+
+OBJECTS_DIR = build
+DESTDIR = bin
+
+
+SOURCES += main.cpp
+
+LIBS += -L../lib -lnidmm
+PRE_TARGETDEPS += ../lib/libnidmm.a
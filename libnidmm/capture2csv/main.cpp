@@ -0,0 +1,103 @@
+// Export a capture file as CSV in engineering units
+//
+// usage: capture2csv capture [output.csv]
+//
+// The header goes into # comment lines, then one line per record with the
+// timestamp, range, raw code, status and the converted value. The codes
+// are converted with RawConverter and the scale stored for their range.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "../capturefile.h"
+#include "../rawconverter.h"
+
+#define RANGE_NAMES(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+        acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    {label, unit},
+
+static const struct {
+    const char *label;
+    const char *unit;
+} rangeNames[NI4050_RANGE_COUNT] = {
+    NI4050_RANGE_TABLE(RANGE_NAMES)
+};
+
+static const char *clockName(int clockId)
+{
+    switch (clockId) {
+    case CLOCK_MONOTONIC:
+        return "CLOCK_MONOTONIC";
+    case CLOCK_BOOTTIME:
+        return "CLOCK_BOOTTIME";
+    case CLOCK_TAI:
+        return "CLOCK_TAI";
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    CaptureReader reader;
+    FILE *out = stdout;
+    std::vector<double> values;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s capture [output.csv]\n", argv[0]);
+        return 2;
+    }
+
+    if (!reader.open(argv[1])) {
+        fprintf(stderr, "%s: %s\n", argv[1], errno == EINVAL ? "not a capture file" : strerror(errno));
+        return 1;
+    }
+    if (argc == 3 && !(out = fopen(argv[2], "w"))) {
+        fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+        return 1;
+    }
+
+    const NI4050CaptureHeader &header = reader.header();
+    fprintf(out, "# device %s\n", header.device);
+    fprintf(out, "# start %llu ns CLOCK_REALTIME\n", (unsigned long long)header.startTime);
+    fprintf(out, "# clock %s\n", clockName(header.clockId));
+    if (header.startRange >= 0 && header.startRange < NI4050_RANGE_COUNT)
+        fprintf(out, "# range %s\n", rangeNames[header.startRange].label);
+    fprintf(out, "# filter %u\n", header.filterCode);
+    fprintf(out, "# internal resistance %u Ohm\n", header.intResistance);
+    for (int i = 0; i < NI4050_RANGE_COUNT; i++)
+        fprintf(out, "# calibration %s zero 0x%06x full 0x%06x\n", rangeNames[i].label,
+                header.calibration[i].zero, header.calibration[i].full);
+    fprintf(out, "timestamp_ns,range,code,status,value,unit\n");
+
+    // convert runs of records taken on the same range in one go
+    uint64_t count = reader.count();
+    for (uint64_t begin = 0, end; begin < count; begin = end) {
+        const NI4050Sample *records = reader.records() + begin;
+        int range = records[0].range;
+
+        for (end = begin + 1; end < count && reader.record(end).range == range; end++)
+            ;
+        if (range >= NI4050_RANGE_COUNT) {
+            fprintf(stderr, "record %llu: invalid range %d\n", (unsigned long long)begin, range);
+            continue;
+        }
+
+        values.resize(end - begin);
+        RawConverter converter(header.scales[range]);
+        converter.convert(records, &values[0], end - begin);
+        for (uint64_t i = 0; i < end - begin; i++)
+            fprintf(out, "%llu,%s,0x%06x,0x%02x,%.9g,%s\n", (unsigned long long)records[i].timestamp,
+                    rangeNames[range].label, records[i].value, records[i].status, values[i],
+                    rangeNames[range].unit);
+    }
+
+    if (out != stdout && fclose(out)) {
+        fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "capturefile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// records start on their own page
+static size_t headerSize()
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (sizeof(NI4050CaptureHeader) + page - 1) / page * page;
+}
+
+CaptureWriter::CaptureWriter(size_t chunkRecords) :
+    m_chunkRecords(chunkRecords ? chunkRecords : 1),
+    m_fd(-1),
+    m_map(0),
+    m_mapSize(0),
+    m_capacity(0),
+    m_count(0),
+    m_header(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const char *path, const NI4050CaptureHeader &header)
+{
+    close();
+
+    m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd == -1)
+        return false;
+
+    m_count = 0;
+    if (!grow()) {
+        int error = errno;
+        close();
+        errno = error;
+        return false;
+    }
+
+    *m_header = header;
+    m_header->magic = NI4050_CAPTURE_MAGIC;
+    m_header->version = NI4050_CAPTURE_VERSION;
+    m_header->headerSize = headerSize();
+    m_header->recordSize = sizeof(NI4050Sample);
+    m_header->recordCount = 0;
+    m_header->device[sizeof(m_header->device) - 1] = 0;
+    return true;
+}
+
+// Add a chunk to the file and map it
+bool CaptureWriter::grow()
+{
+    size_t size = headerSize() + (m_capacity + m_chunkRecords) * sizeof(NI4050Sample);
+    char *map;
+
+    // real blocks if the file system can, so the page faults of append()
+    // find them; a sparse file otherwise
+    if (fallocate(m_fd, 0, m_mapSize, size - m_mapSize) == -1 && ftruncate(m_fd, size) == -1)
+        return false;
+
+    if (m_map)
+        map = (char *)mremap(m_map, m_mapSize, size, MREMAP_MAYMOVE);
+    else
+        map = (char *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    m_map = map;
+    m_mapSize = size;
+    m_capacity += m_chunkRecords;
+    m_header = (NI4050CaptureHeader *)m_map;
+    return true;
+}
+
+bool CaptureWriter::append(const NI4050Sample &sample)
+{
+    if (m_count == m_capacity && !grow())
+        return false;
+
+    NI4050Sample *records = (NI4050Sample *)(m_map + m_header->headerSize);
+    records[m_count++] = sample;
+    m_header->recordCount = m_count;
+    return true;
+}
+
+bool CaptureWriter::close()
+{
+    bool ok = true;
+
+    if (m_fd == -1)
+        return true;
+
+    if (m_map) {
+        size_t size = m_header->headerSize + m_count * sizeof(NI4050Sample);
+        munmap(m_map, m_mapSize);
+        ok = ftruncate(m_fd, size) == 0;
+    }
+    ok = ::close(m_fd) == 0 && ok;
+
+    m_fd = -1;
+    m_map = 0;
+    m_mapSize = 0;
+    m_capacity = 0;
+    m_header = 0;
+    return ok;
+}
+
+CaptureReader::CaptureReader() :
+    m_map(0),
+    m_mapSize(0),
+    m_header(0),
+    m_records(0),
+    m_count(0)
+{
+}
+
+CaptureReader::~CaptureReader()
+{
+    close();
+}
+
+bool CaptureReader::open(const char *path)
+{
+    struct stat st;
+    int fd;
+
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    if (fstat(fd, &st) == -1) {
+        ::close(fd);
+        return false;
+    }
+    if ((size_t)st.st_size < sizeof(NI4050CaptureHeader)) {
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    m_map = (char *)mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_map == MAP_FAILED) {
+        m_map = 0;
+        return false;
+    }
+    m_mapSize = st.st_size;
+    m_header = (const NI4050CaptureHeader *)m_map;
+
+    if (m_header->magic != NI4050_CAPTURE_MAGIC || m_header->version != NI4050_CAPTURE_VERSION ||
+        m_header->recordSize != sizeof(NI4050Sample) || m_header->headerSize > m_mapSize) {
+        close();
+        errno = EINVAL;
+        return false;
+    }
+
+    m_records = (const NI4050Sample *)(m_map + m_header->headerSize);
+    uint64_t fits = (m_mapSize - m_header->headerSize) / sizeof(NI4050Sample);
+    m_count = m_header->recordCount < fits ? m_header->recordCount : fits;
+    // a writer that did not close left its count behind the last records
+    while (m_count < fits && m_records[m_count].timestamp != 0)
+        m_count++;
+    return true;
+}
+
+void CaptureReader::close()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    m_map = 0;
+    m_mapSize = 0;
+    m_header = 0;
+    m_records = 0;
+    m_count = 0;
+}
+
+double CaptureReader::value(uint64_t i) const
+{
+    const NI4050Sample &sample = m_records[i];
+
+    if (sample.range >= NI4050_RANGE_COUNT)
+        return 0;
+    return ni4050ConvertRaw(&m_header->scales[sample.range], sample.value);
+}
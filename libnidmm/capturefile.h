@@ -0,0 +1,108 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+#include "../module/ni4050.h"
+
+// Capture file layout
+//
+// A NI4050CaptureHeader at offset 0, then NI4050Sample records from
+// headerSize on, in the byte order of the machine that wrote them. The
+// header carries everything needed to convert the codes offline: the scale
+// and the EEPROM calibration words of every range, since autoranging may
+// switch ranges during the capture. recordCount is kept up to date while
+// recording; after a crash the reader also takes the records behind it up
+// to the first zero timestamp of the preallocated tail.
+#define	NI4050_CAPTURE_MAGIC	0x4350414eU	// "NAPC"
+#define	NI4050_CAPTURE_VERSION	1
+
+typedef struct
+{
+    uint32_t zero;	// NI4050_EEPROM_CAL_ZERO word of the default filter
+    uint32_t full;	// NI4050_EEPROM_CAL_FULL word
+} NI4050CaptureCalibration;
+
+typedef struct
+{
+    uint32_t magic;			// NI4050_CAPTURE_MAGIC
+    uint32_t version;		// NI4050_CAPTURE_VERSION
+    uint32_t headerSize;	// offset of the first record
+    uint32_t recordSize;	// sizeof(NI4050Sample)
+    uint64_t recordCount;
+    uint64_t startTime;		// CLOCK_REALTIME ns when the capture began
+    int32_t clockId;		// clock of the record timestamps, see NIDMM_IOCSETCLOCK
+    int32_t startRange;		// NI4050_RANGES when the capture began
+    uint32_t filterCode;	// ADC filter word, 0 for the default of every range
+    uint32_t intResistance;	// Ohm
+    char device[64];		// path of the device node, zero terminated
+    NI4050Scale scales[NI4050_RANGE_COUNT];	// indexed by NI4050_RANGES
+    NI4050CaptureCalibration calibration[NI4050_RANGE_COUNT];
+} NI4050CaptureHeader;
+
+// Appends records to a capture file through a shared mapping.
+//
+// The file grows by chunks of chunkRecords records which are allocated and
+// mapped ahead, so append() is a memory copy and never waits for write().
+// Not thread safe, one writer per file.
+class CaptureWriter
+{
+public:
+    enum {
+        DefaultChunkRecords = 1 << 18	// 4 MiB
+    };
+
+    explicit CaptureWriter(size_t chunkRecords = DefaultChunkRecords);
+    ~CaptureWriter();
+
+    // Create or truncate path, the header is copied with its sizes and
+    // count filled in. false with errno set on failure.
+    bool open(const char *path, const NI4050CaptureHeader &header);
+    bool isOpen() const { return m_fd != -1; }
+    // false with errno set if the file could not grow
+    bool append(const NI4050Sample &sample);
+    uint64_t count() const { return m_count; }
+    // Trim the preallocated tail and close the file
+    bool close();
+
+private:
+    bool grow();
+
+    size_t m_chunkRecords;
+    int m_fd;
+    char *m_map;
+    size_t m_mapSize;
+    size_t m_capacity;	// records that fit the mapping
+    uint64_t m_count;
+    NI4050CaptureHeader *m_header;	// in the mapping
+};
+
+// Read-only view of a capture file
+class CaptureReader
+{
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    // false with errno set on failure, EINVAL if it is no capture file
+    bool open(const char *path);
+    void close();
+
+    const NI4050CaptureHeader &header() const { return *m_header; }
+    uint64_t count() const { return m_count; }
+    const NI4050Sample &record(uint64_t i) const { return m_records[i]; }
+    const NI4050Sample *records() const { return m_records; }
+    // Engineering units of record i with the scale stored for its range
+    double value(uint64_t i) const;
+
+private:
+    char *m_map;
+    size_t m_mapSize;
+    const NI4050CaptureHeader *m_header;
+    const NI4050Sample *m_records;
+    uint64_t m_count;
+};
+
+#endif // CAPTUREFILE_H
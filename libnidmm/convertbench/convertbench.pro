@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Throughput and bit-exactness check of RawConverter
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = convertbench
+TEMPLATE = app
+CONFIG += console
+
+OBJECTS_DIR = build
+DESTDIR = bin
+
+QMAKE_CXXFLAGS += -ffp-contract=off
+
+
+SOURCES += main.cpp
+
+LIBS += -L../lib -lnidmm
+PRE_TARGETDEPS += ../lib/libnidmm.a
@@ -0,0 +1,62 @@
+// Throughput and bit-exactness check of the RawConverter kernels
+//
+// For every range and every kernel the CPU supports it prints the
+// conversion rate and whether the output matches ni4050ConvertRaw()
+// bit by bit. Exits with 1 on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "../rawconverter.h"
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? strtoul(argv[1], 0, 0) : (1 << 20);
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    const RawConverter::Kernel kernels[] = {
+        RawConverter::KernelScalar, RawConverter::KernelSSE2, RawConverter::KernelAVX2
+    };
+    std::vector<unsigned int> codes(count);
+    std::vector<double> reference(count), values(count);
+    bool exact = true;
+
+    srand(4050);
+    for (size_t i = 0; i < count; i++)
+        codes[i] = ((unsigned int)rand() ^ ((unsigned int)rand() << 12)) & 0xffffff;
+
+    printf("%-8s %-7s %14s %s\n", "range", "kernel", "samples/s", "bit-exact");
+    for (int range = NI4050_RANGE_250VDC; range < NI4050_RANGE_COUNT; range++) {
+        NI4050Scale scale;
+        RawConverter::scaleForRange((NI4050_RANGES)range, NI4050_INTERNAL_RESISTANCE_SPEC_MAX, &scale);
+        for (size_t i = 0; i < count; i++)
+            reference[i] = ni4050ConvertRaw(&scale, codes[i]);
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if (!RawConverter::kernelSupported(kernels[k]))
+                continue;
+
+            RawConverter converter(scale, kernels[k]);
+            double start = now();
+            for (int r = 0; r < rounds; r++)
+                converter.convert(&codes[0], &values[0], count);
+            double elapsed = now() - start;
+
+            bool same = !memcmp(&values[0], &reference[0], count * sizeof(double));
+            exact = exact && same;
+            printf("%-8d %-7s %14.0f %s\n", range, RawConverter::kernelName(kernels[k]),
+                   count * rounds / elapsed, same ? "yes" : "NO");
+        }
+    }
+
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+#include "groupacquisition.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+GroupAcquisition::GroupAcquisition() :
+    m_count(0),
+    m_tolerance(0)
+{
+    for (int i = 0; i < NI4050_GROUP_MAX; i++)
+        m_fd[i] = -1;
+    memset(m_skew, 0, sizeof(m_skew));
+    memset(m_skewM2, 0, sizeof(m_skewM2));
+}
+
+GroupAcquisition::~GroupAcquisition()
+{
+    close();
+}
+
+bool GroupAcquisition::open(const char *const *paths, unsigned int count)
+{
+    close();
+
+    if (count == 0 || count > NI4050_GROUP_MAX) {
+        errno = EINVAL;
+        return false;
+    }
+
+    for (m_count = 0; m_count < count; m_count++) {
+        m_fd[m_count] = ::open(paths[m_count], O_RDWR | O_NONBLOCK);
+        if (m_fd[m_count] == -1) {
+            int error = errno;
+            close();
+            errno = error;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GroupAcquisition::close()
+{
+    for (unsigned int i = 0; i < m_count; i++) {
+        ::close(m_fd[i]);
+        m_fd[i] = -1;
+        m_pending[i].clear();
+    }
+    m_count = 0;
+}
+
+bool GroupAcquisition::start(const NI4050_RANGES *ranges, unsigned int filterCode)
+{
+    NI4050ContinuousMode continuousMode;
+    NI4050GroupStart group;
+    NI4050Filter filter;
+    unsigned int i;
+
+    stop();
+
+    memset(&group, 0, sizeof(group));
+    group.count = m_count;
+    for (i = 0; i < m_count; i++) {
+        // the same rate on every card, or the frames would not pair up
+        filter.range = ranges[i];
+        filter.filterCode = filterCode;
+        filter.preset = 0;
+        if (ioctl(m_fd[i], NIDMM_IOCSETFILTER, &filter) == -1)
+            return false;
+
+        group.fd[i] = m_fd[i];
+        group.range[i] = ranges[i];
+    }
+
+    if (ioctl(m_fd[0], NIDMM_IOCGROUPSTART, &group) == -1)
+        return false;
+
+    // the first conversion takes three periods to settle, nothing is
+    // missed by turning the fifos on only now
+    continuousMode.enable = 1;
+    continuousMode.overrunPolicy = NI4050_OVERRUN_DROP_OLDEST;
+    for (i = 0; i < m_count; i++)
+        if (ioctl(m_fd[i], NIDMM_IOCSETCONTINUOUS, &continuousMode) == -1)
+            return false;
+
+    m_tolerance = (uint64_t)filterCode * 1000000000ULL / 19200 / 2;
+    memset(m_skew, 0, sizeof(m_skew));
+    memset(m_skewM2, 0, sizeof(m_skewM2));
+    for (i = 0; i < m_count; i++)
+        m_skew[i].startNs = (int64_t)(group.started[i] - group.started[0]);
+
+    return true;
+}
+
+void GroupAcquisition::stop()
+{
+    NI4050ContinuousMode continuousMode;
+
+    continuousMode.enable = 0;
+    continuousMode.overrunPolicy = NI4050_OVERRUN_DROP_OLDEST;
+    for (unsigned int i = 0; i < m_count; i++) {
+        ioctl(m_fd[i], NIDMM_IOCSETCONTINUOUS, &continuousMode);
+        m_pending[i].clear();
+    }
+}
+
+int GroupAcquisition::read(Frame *frames, unsigned int count, int timeoutMs)
+{
+    unsigned int n = merge(frames, count);
+
+    if (n == 0 && count) {
+        if (!collect(timeoutMs))
+            return -1;
+        n = merge(frames, count);
+    }
+
+    return n;
+}
+
+// Wait for the first card with data, then take what every card has
+bool GroupAcquisition::collect(int timeoutMs)
+{
+    struct pollfd fds[NI4050_GROUP_MAX];
+    NI4050Sample samples[64];
+    unsigned int i;
+    ssize_t size;
+
+    for (i = 0; i < m_count; i++) {
+        fds[i].fd = m_fd[i];
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    if (poll(fds, m_count, timeoutMs) == -1)
+        return errno == EINTR;
+
+    for (i = 0; i < m_count; i++) {
+        if (fds[i].revents & (POLLERR | POLLHUP)) {
+            errno = ENODEV;
+            return false;
+        }
+
+        while ((size = ::read(m_fd[i], samples, sizeof(samples))) > 0)
+            m_pending[i].insert(m_pending[i].end(), samples,
+                                samples + size / sizeof(NI4050Sample));
+        if (size == -1 && errno != EAGAIN && errno != EINTR)
+            return false;
+    }
+
+    return true;
+}
+
+// Pair up the pending conversions. The latest head is the reference, heads
+// more than m_tolerance before it can not have a partner any more.
+unsigned int GroupAcquisition::merge(Frame *frames, unsigned int count)
+{
+    unsigned int n = 0, i;
+    uint64_t latest;
+    bool dropped;
+
+    while (n < count) {
+        latest = 0;
+        for (i = 0; i < m_count; i++) {
+            if (m_pending[i].empty())
+                return n;
+            if (m_pending[i].front().timestamp > latest)
+                latest = m_pending[i].front().timestamp;
+        }
+
+        dropped = false;
+        for (i = 0; i < m_count; i++) {
+            if (m_pending[i].front().timestamp + m_tolerance < latest) {
+                m_pending[i].pop_front();
+                m_skew[i].unmatched++;
+                dropped = true;
+            }
+        }
+        if (dropped)
+            continue;
+
+        for (i = 0; i < m_count; i++) {
+            frames[n].samples[i] = m_pending[i].front();
+            m_pending[i].pop_front();
+        }
+        frames[n].timestamp = frames[n].samples[0].timestamp;
+        account(frames[n]);
+        n++;
+    }
+
+    return n;
+}
+
+void GroupAcquisition::account(const Frame &frame)
+{
+    for (unsigned int i = 0; i < m_count; i++) {
+        Skew *skew = &m_skew[i];
+        int64_t ns = (int64_t)(frame.samples[i].timestamp - frame.timestamp);
+        double delta;
+
+        if (skew->frames == 0 || ns < skew->minNs)
+            skew->minNs = ns;
+        if (skew->frames == 0 || ns > skew->maxNs)
+            skew->maxNs = ns;
+
+        // Welford, stays exact over long runs
+        skew->frames++;
+        delta = ns - skew->meanNs;
+        skew->meanNs += delta / skew->frames;
+        m_skewM2[i] += delta * (ns - skew->meanNs);
+        skew->stddevNs = sqrt(m_skewM2[i] / skew->frames);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef GROUPACQUISITION_H
+#define GROUPACQUISITION_H
+
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+#include <deque>
+
+#include "../module/ni4050.h"
+
+// Synchronized acquisition of several cards.
+//
+// start() programs the same filter word on every card, so they convert at
+// the same rate, and starts them in step with NIDMM_IOCGROUPSTART in
+// continuous mode. read() then collects what the cards delivered and
+// pairs their conversions up by timestamp into frames, one conversion of
+// every card each. A conversion which finds no partner within half a
+// conversion period is dropped and counted as unmatched.
+class GroupAcquisition
+{
+public:
+    // Conversions of the members, in the order they were opened
+    struct Frame {
+        uint64_t timestamp;		// of the first member
+        NI4050Sample samples[NI4050_GROUP_MAX];
+    };
+
+    // Timing of one member relative to the first one, in ns
+    struct Skew {
+        int64_t startNs;		// filter release, from NIDMM_IOCGROUPSTART
+        int64_t minNs;			// conversion timestamps of the frames
+        int64_t maxNs;
+        double meanNs;
+        double stddevNs;
+        uint64_t frames;
+        uint64_t unmatched;		// conversions dropped without a frame
+    };
+
+    enum {
+        DefaultFilterCode = 1920	// 10 Hz
+    };
+
+    GroupAcquisition();
+    ~GroupAcquisition();
+
+    // Open up to NI4050_GROUP_MAX device nodes, false with errno set on failure
+    bool open(const char *const *paths, unsigned int count);
+    void close();
+    unsigned int count() const { return m_count; }
+    // Descriptor of member i, e.g. for NIDMM_IOCGETSCALE
+    int fd(unsigned int i) const { return m_fd[i]; }
+
+    // Start member i on ranges[i]. false with errno set on failure.
+    bool start(const NI4050_RANGES *ranges, unsigned int filterCode = DefaultFilterCode);
+    void stop();
+
+    // Wait up to timeoutMs for conversions and merge them. Returns the
+    // number of frames stored, -1 with errno set on failure.
+    int read(Frame *frames, unsigned int count, int timeoutMs);
+
+    const Skew &skew(unsigned int i) const { return m_skew[i]; }
+
+private:
+    bool collect(int timeoutMs);
+    unsigned int merge(Frame *frames, unsigned int count);
+    void account(const Frame &frame);
+
+    unsigned int m_count;
+    int m_fd[NI4050_GROUP_MAX];
+    std::deque<NI4050Sample> m_pending[NI4050_GROUP_MAX];
+    uint64_t m_tolerance;	// ns, half a conversion period
+    Skew m_skew[NI4050_GROUP_MAX];
+    double m_skewM2[NI4050_GROUP_MAX];	// running sum of squares for stddevNs
+};
+
+#endif // GROUPACQUISITION_H
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Userspace helpers for the ni4050 driver
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = nidmm
+TEMPLATE = lib
+CONFIG += staticlib
+
+OBJECTS_DIR = build
+DESTDIR = lib
+
+# the vector kernels must round exactly like ni4050ConvertRaw()
+QMAKE_CXXFLAGS += -ffp-contract=off
+
+
+SOURCES += rawconverter.cpp \
+        capturefile.cpp \
+        groupacquisition.cpp
+
+HEADERS  += rawconverter.h \
+        capturefile.h \
+        groupacquisition.h
@@ -0,0 +1,212 @@
+#include "rawconverter.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define RAWCONVERTER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct RangeScale {
+    unsigned int num;
+    unsigned int den;
+    unsigned int flags;
+};
+
+#define RANGE_SCALE(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+        acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    { NI4050_CONVERT_RANGE_##scale##_NUM, NI4050_CONVERT_RANGE_##scale##_DEN, flags },
+
+// Same table the driver hands out through NIDMM_IOCGETSCALE, indexed by NI4050_RANGES
+const RangeScale rangeScales[NI4050_RANGE_COUNT] = {
+    NI4050_RANGE_TABLE(RANGE_SCALE)
+};
+
+// The reference, every vector kernel has to match it bit by bit
+void convertScalar(const NI4050Scale &scale, const unsigned int *codes, double *values, size_t count)
+{
+    // ni4050ConvertRaw() recomputes the factor for every code
+    for (size_t i = 0; i < count; i++)
+        values[i] = ni4050ConvertRaw(&scale, codes[i]);
+}
+
+#ifdef RAWCONVERTER_X86
+
+// (code - zero) * factor, then x * R / (R - x) for EXTOHM
+template <bool ExtOhm>
+__attribute__((target("sse2")))
+void convertSSE2(const NI4050Scale &scale, const unsigned int *codes, double *values, size_t count)
+{
+    const __m128i zero = _mm_set1_epi32(scale.zeroCode);
+    const __m128d factor = _mm_set1_pd(ni4050ScaleFactor(&scale));
+    const __m128d r = _mm_set1_pd(scale.intResistance);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(codes + i)), zero);
+        __m128d lo = _mm_cvtepi32_pd(diff);
+        __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(diff, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        lo = _mm_mul_pd(lo, factor);
+        hi = _mm_mul_pd(hi, factor);
+        if (ExtOhm) {
+            lo = _mm_div_pd(_mm_mul_pd(lo, r), _mm_sub_pd(r, lo));
+            hi = _mm_div_pd(_mm_mul_pd(hi, r), _mm_sub_pd(r, hi));
+        }
+
+        _mm_storeu_pd(values + i, lo);
+        _mm_storeu_pd(values + i + 2, hi);
+    }
+
+    convertScalar(scale, codes + i, values + i, count - i);
+}
+
+template <bool ExtOhm>
+__attribute__((target("avx2")))
+void convertAVX2(const NI4050Scale &scale, const unsigned int *codes, double *values, size_t count)
+{
+    const __m256i zero = _mm256_set1_epi32(scale.zeroCode);
+    const __m256d factor = _mm256_set1_pd(ni4050ScaleFactor(&scale));
+    const __m256d r = _mm256_set1_pd(scale.intResistance);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(codes + i)), zero);
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(diff));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(diff, 1));
+
+        lo = _mm256_mul_pd(lo, factor);
+        hi = _mm256_mul_pd(hi, factor);
+        if (ExtOhm) {
+            lo = _mm256_div_pd(_mm256_mul_pd(lo, r), _mm256_sub_pd(r, lo));
+            hi = _mm256_div_pd(_mm256_mul_pd(hi, r), _mm256_sub_pd(r, hi));
+        }
+
+        _mm256_storeu_pd(values + i, lo);
+        _mm256_storeu_pd(values + i + 4, hi);
+    }
+
+    convertScalar(scale, codes + i, values + i, count - i);
+}
+
+#endif // RAWCONVERTER_X86
+
+} // namespace
+
+RawConverter::RawConverter(const NI4050Scale &scale, Kernel kernel) :
+    m_scale(scale)
+{
+    setKernel(kernel);
+}
+
+RawConverter::RawConverter(NI4050_RANGES range, unsigned int intResistance, Kernel kernel)
+{
+    if (!scaleForRange(range, intResistance, &m_scale))
+        scaleForRange(NI4050_RANGE_250VDC, intResistance, &m_scale);
+    setKernel(kernel);
+}
+
+void RawConverter::setKernel(Kernel kernel)
+{
+    if (kernel == KernelAuto || !kernelSupported(kernel))
+        kernel = bestKernel();
+    m_kernel = kernel;
+}
+
+void RawConverter::convert(const unsigned int *codes, double *values, size_t count) const
+{
+    bool extOhm = m_scale.flags & NI4050_SCALE_EXTOHM;
+
+    switch (m_kernel) {
+#ifdef RAWCONVERTER_X86
+    case KernelAVX2:
+        if (extOhm)
+            convertAVX2<true>(m_scale, codes, values, count);
+        else
+            convertAVX2<false>(m_scale, codes, values, count);
+        break;
+    case KernelSSE2:
+        if (extOhm)
+            convertSSE2<true>(m_scale, codes, values, count);
+        else
+            convertSSE2<false>(m_scale, codes, values, count);
+        break;
+#endif
+    default:
+        (void)extOhm;
+        convertScalar(m_scale, codes, values, count);
+        break;
+    }
+}
+
+void RawConverter::convert(const NI4050Sample *samples, double *values, size_t count) const
+{
+    unsigned int codes[256];
+
+    while (count) {
+        size_t n = count < 256 ? count : 256;
+        for (size_t i = 0; i < n; i++)
+            codes[i] = samples[i].value;
+
+        convert(codes, values, n);
+        samples += n;
+        values += n;
+        count -= n;
+    }
+}
+
+bool RawConverter::scaleForRange(NI4050_RANGES range, unsigned int intResistance, NI4050Scale *scale)
+{
+    if (range < 0 || range >= NI4050_RANGE_COUNT)
+        return false;
+
+    scale->range = range;
+    scale->zeroCode = NI4050_CONVERT_CODE_ZERO;
+    scale->codeSpan = NI4050_CONVERT_CODE_SPAN;
+    scale->scaleNum = rangeScales[range].num;
+    scale->scaleDen = rangeScales[range].den;
+    scale->intResistance = intResistance;
+    scale->flags = rangeScales[range].flags;
+    scale->reserved = 0;
+    return true;
+}
+
+bool RawConverter::kernelSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case KernelScalar:
+        return true;
+#ifdef RAWCONVERTER_X86
+    case KernelSSE2:
+        return __builtin_cpu_supports("sse2");
+    case KernelAVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+RawConverter::Kernel RawConverter::bestKernel()
+{
+    if (kernelSupported(KernelAVX2))
+        return KernelAVX2;
+    if (kernelSupported(KernelSSE2))
+        return KernelSSE2;
+    return KernelScalar;
+}
+
+const char *RawConverter::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case KernelAuto:
+        return "auto";
+    case KernelScalar:
+        return "scalar";
+    case KernelSSE2:
+        return "sse2";
+    case KernelAVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
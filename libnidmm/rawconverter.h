@@ -0,0 +1,46 @@
+#ifndef RAWCONVERTER_H
+#define RAWCONVERTER_H
+
+#include <stddef.h>
+#include <sys/ioctl.h>
+
+#include "../module/ni4050.h"
+
+// Batch conversion of raw NI4050 codes to engineering units.
+//
+// The results are bit-exact with ni4050ConvertRaw(): every kernel does the
+// same IEEE operations in the same order, only several lanes at once.
+class RawConverter
+{
+public:
+    enum Kernel {
+        KernelAuto,
+        KernelScalar,
+        KernelSSE2,
+        KernelAVX2
+    };
+
+    // Scale reported by the driver for the running measurement
+    explicit RawConverter(const NI4050Scale &scale, Kernel kernel = KernelAuto);
+    // Scale built from the NI4050_CONVERT_RANGE_* table, no device needed
+    RawConverter(NI4050_RANGES range, unsigned int intResistance, Kernel kernel = KernelAuto);
+
+    const NI4050Scale &scale() const { return m_scale; }
+    Kernel kernel() const { return m_kernel; }
+
+    void convert(const unsigned int *codes, double *values, size_t count) const;
+    void convert(const NI4050Sample *samples, double *values, size_t count) const;
+
+    static bool scaleForRange(NI4050_RANGES range, unsigned int intResistance, NI4050Scale *scale);
+    static bool kernelSupported(Kernel kernel);
+    static Kernel bestKernel();
+    static const char *kernelName(Kernel kernel);
+
+private:
+    void setKernel(Kernel kernel);
+
+    NI4050Scale m_scale;
+    Kernel m_kernel;
+};
+
+#endif // RAWCONVERTER_H
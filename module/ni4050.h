@@ -9,30 +9,231 @@ typedef struct
 	unsigned char data;
 } EEPROMInfo;
 
+// Range descriptors
+//
+// One X() line per measurement range, the NI4050_RANGES values are numbered
+// in this order. The columns are the suffixes of the constants below:
+//   range             NI4050_RANGE_*, NI4050_ADC_WRITE_GAIN_*
+//   eepromMode        NI4050_EEPROM_MODE_*
+//   eepromRange       NI4050_EEPROM_RANGE_*
+//   calFilter         NI4050_EEPROM_FILTER_*, default calibration set
+//   filter            NI4050_ADC_WRITE_FILTERHIGH/LOW_*, default filter
+//   inputRange        NI4050_CONFIG_I_R_*
+//   ohmsMode          NI4050_CONFIG_OHMS_*
+//   acRange           NI4050_CONFIG_AC_R_*
+//   ohmsRange         NI4050_CONFIG_O_R_*
+//   adcMode           NI4050_ADC_COMMAND_MODE_*
+//   scale             NI4050_CONVERT_RANGE_*_NUM/_DEN
+// followed by the NI4050Scale flags, the unit ni4050ConvertRaw() returns,
+// and the label and title shown to the user.
+#define NI4050_RANGE_TABLE(X) \
+	X(250VDC,  VDC,   250V,    10HZ, 10HZ, 250VDC,  VDCVAC, VDC,     VDC,    VDC,   250VDC,  0, "V",   "250VDC",  "Voltage") \
+	X(25VDC,   VDC,   25V,     50HZ, 50HZ, 25VDC,   VDCVAC, VDC,     VDC,    VDC,   25VDC,   0, "V",   "25VDC",   "Voltage") \
+	X(2VDC,    VDC,   2V,      60HZ, 60HZ, 2VDC,    VDCVAC, VDC,     VDC,    VDC,   2VDC,    0, "V",   "2VDC",    "Voltage") \
+	X(200mVDC, VDC,   200mV,   60HZ, 60HZ, 200mVDC, VDCVAC, VDC,     VDC,    VDC,   200mVDC, 0, "V",   "200mVDC", "Voltage") \
+	X(20mVDC,  VDC,   20mV,    60HZ, 60HZ, 20mVDC,  VDCVAC, VDC,     VDC,    VDC,   20mVDC,  0, "V",   "20mVDC",  "Voltage") \
+	X(250VAC,  VAC,   250V,    60HZ, 60HZ, 250VAC,  VDCVAC, 250VAC,  VAC,    VAC,   250VAC,  0, "V",   "250VAC",  "Voltage") \
+	X(25VAC,   VAC,   25V,     10HZ, 10HZ, 25VAC,   VDCVAC, 25VAC,   VAC,    VAC,   25VAC,   0, "V",   "25VAC",   "Voltage") \
+	X(2VAC,    VAC,   2V,      10HZ, 10HZ, 2VAC,    VDCVAC, 2VAC,    VAC,    VAC,   2VAC,    0, "V",   "2VAC",    "Voltage") \
+	X(200mVAC, VAC,   200mV,   50HZ, 50HZ, 200mVAC, VDCVAC, 200mVAC, VAC,    VAC,   200mVAC, 0, "V",   "200mVAC", "Voltage") \
+	X(20mVAC,  VAC,   20mV,    50HZ, 50HZ, 20mVAC,  VDCVAC, 20mVAC,  VAC,    VAC,   20mVAC,  0, "V",   "20mVAC",  "Voltage") \
+	X(EXTOHM,  OHMS,  EXTOHM,  10HZ, 10HZ, EXTOHMS, OHMS,   OHMS,    EXTOHM, OHMS,  2MOHM,   NI4050_SCALE_EXTOHM, "Ohm", "EXTOHM", "Resistance") \
+	X(2MOHM,   OHMS,  2MOHM,   10HZ, 10HZ, OHMS,    OHMS,   OHMS,    2MOHM,  OHMS,  2MOHM,   0, "Ohm", "2MOHM",   "Resistance") \
+	X(200kOHM, OHMS,  200kOHM, 10HZ, 10HZ, OHMS,    OHMS,   OHMS,    200kOHM, OHMS, 200kOHM, 0, "Ohm", "200kOHM", "Resistance") \
+	X(20kOHM,  OHMS,  20kOHM,  10HZ, 10HZ, OHMS,    OHMS,   OHMS,    20kOHM, OHMS,  20kOHM,  0, "Ohm", "20kOHM",  "Resistance") \
+	X(2kOHM,   OHMS,  2kOHM,   10HZ, 10HZ, OHMS,    OHMS,   OHMS,    2kOHM,  OHMS,  2kOHM,   0, "Ohm", "2kOHM",   "Resistance") \
+	X(200OHM,  OHMS,  200OHM,  10HZ, 10HZ, OHMS,    OHMS,   OHMS,    200OHM, OHMS,  200OHM,  0, "Ohm", "200OHM",  "Resistance") \
+	X(DIODE,   DIODE, DIODE,   50HZ, 60HZ, DIODE,   DIODE,  DIODE,   DIODE,  DIODE, DIODE,   0, "V",   "DIODE",   "Forward voltage")
+
+#define NI4050_RANGE_ENUM(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+		acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+	NI4050_RANGE_##range,
+
 typedef enum _NI4050_RANGES
 {
    NI4050_RANGE_INVALID = -1, 
-   NI4050_RANGE_250VDC = 0, 
-   NI4050_RANGE_25VDC,
-   NI4050_RANGE_2VDC,
-   NI4050_RANGE_200mVDC,
-   NI4050_RANGE_20mVDC,
-   NI4050_RANGE_250VAC,
-   NI4050_RANGE_25VAC,
-   NI4050_RANGE_2VAC,
-   NI4050_RANGE_200mVAC,
-   NI4050_RANGE_20mVAC,
-   NI4050_RANGE_EXTOHM,
-   NI4050_RANGE_2MOHM,
-   NI4050_RANGE_200kOHM,
-   NI4050_RANGE_20kOHM,
-   NI4050_RANGE_2kOHM,
-   NI4050_RANGE_200OHM,
-   NI4050_RANGE_DIODE
+   NI4050_RANGE_TABLE(NI4050_RANGE_ENUM)
+   NI4050_RANGE_COUNT
 } NI4050_RANGES;
 
+// The numbers are part of the ioctl ABI, rows may only be appended
+typedef char NI4050RangeAbiCheck[(NI4050_RANGE_250VDC == 0 && NI4050_RANGE_EXTOHM == 10 &&
+		NI4050_RANGE_DIODE == 16 && NI4050_RANGE_COUNT == 17) ? 1 : -1];
+
 
-#define	NI4050_MAX_DEV		4
+// One conversion as delivered by read() and NIDMM_IOCREADSAMPLES
+typedef struct
+{
+	__u64 timestamp;	// ns when NEW_DATA was seen, clock set by NIDMM_IOCSETCLOCK
+	__u32 value;		// raw 24-bit ADC code
+	__u8 status;		// NI4050_STATUS_* bits latched with the conversion
+	__u8 range;			// NI4050_RANGES the card was programmed to
+	__u16 reserved;
+} NI4050Sample;
+
+// What to throw away when the continuous buffer is full. Only the
+// controller chooses and only for itself, a subscriber always loses the
+// oldest records.
+#define	NI4050_OVERRUN_DROP_OLDEST	0
+#define	NI4050_OVERRUN_DROP_NEWEST	1
+
+typedef struct
+{
+	unsigned int enable;
+	unsigned int overrunPolicy;	// NI4050_OVERRUN_*
+} NI4050ContinuousMode;
+
+// First page of the sample ring mapped with mmap(), the NI4050Sample
+// records follow at the next page. The driver advances head when it
+// publishes a record in continuous mode, the reader advances tail. While
+// a ring is mapped the samples go there as well as to read(). Only the
+// controller may map it.
+typedef struct
+{
+	__u32 magic;			// NI4050_RING_MAGIC
+	__u32 recordSize;		// sizeof(NI4050Sample)
+	__u32 capacity;			// records in the ring, a power of 2
+	__u32 recordOffset;		// byte offset of the first record
+	__u64 head;				// records published, written by the driver
+	__u64 tail;				// records consumed, written by the reader
+	__u64 overruns;			// records lost because the ring was full
+} NI4050RingHeader;
+
+#define	NI4050_RING_MAGIC		0x4e495247
+#define	NI4050_RING_MAX_SIZE	(4 * 1024 * 1024)
+
+// Argument of NIDMM_IOCREADSAMPLES
+typedef struct
+{
+	__u64 samples;		// user pointer to an NI4050Sample array
+	__u32 count;		// in: array length, out: records filled
+	__u32 flags;		// NI4050_READ_*
+} NI4050SampleBatch;
+
+// Argument of NIDMM_IOCEEPROMREADBLOCK. The bytes come from the image of
+// the whole EEPROM the driver reads at probe time and again on
+// NIDMM_IOCRELOADCALIBRATION, the same one sysfs shows as
+// /sys/class/ni_4050/nidmmN/eeprom.
+typedef struct
+{
+	__u32 address;		// first byte, below NI4050_EEPROM_SIZE
+	__u32 length;		// in: bytes wanted, out: bytes copied
+	__u64 data;			// user pointer to length bytes
+} NI4050EepromBlock;
+
+// Block until all records are filled, not only the first one
+#define	NI4050_READ_WAITALL		0x01
+
+// Integer description of the code to engineering unit conversion of a range:
+// value = (code - zeroCode) * scaleNum / (scaleDen * codeSpan)
+// With NI4050_SCALE_EXTOHM the result x is then linearized with the internal
+// resistance as x * intResistance / (intResistance - x).
+typedef struct
+{
+	__s32 range;			// in: NI4050_RANGES, NI4050_RANGE_INVALID for the current one
+	__u32 zeroCode;
+	__u32 codeSpan;
+	__u32 scaleNum;
+	__u32 scaleDen;
+	__u32 intResistance;	// Ohm
+	__u32 flags;			// NI4050_SCALE_*
+	__u32 reserved;
+} NI4050Scale;
+
+#define	NI4050_SCALE_EXTOHM		0x01
+
+// Filter presets, the EEPROM holds a calibration set for each of them
+#define	NI4050_FILTER_10HZ		0
+#define	NI4050_FILTER_50HZ		1
+#define	NI4050_FILTER_60HZ		2
+#define	NI4050_FILTER_PRESETS	3
+
+// Argument of NIDMM_IOCSETFILTER, used from the next start of the range.
+//
+// The filter word (FS11..FS0 of the ADC filter register) sets the first
+// notch and the output data rate to 19200 Hz / filterCode, for codes from
+// NI4050_FILTER_CODE_MIN (1010.5 Hz) to NI4050_FILTER_CODE_MAX (4.8 Hz).
+// The presets are 1920 (10 Hz), 384 (50 Hz) and 320 (60 Hz). A reading
+// settles in three conversions after a start or range switch. Arbitrary
+// codes are calibrated with the preset of the nearest filter word.
+typedef struct
+{
+	__s32 range;			// NI4050_RANGES
+	__u32 filterCode;		// in: 0 to use the preset; out: word programmed
+	__u32 preset;			// in: NI4050_FILTER_*; out: calibration set used
+	__u32 rateMilliHz;		// out: output data rate
+} NI4050Filter;
+
+#define	NI4050_FILTER_CODE_MIN		19
+#define	NI4050_FILTER_CODE_MAX		4000
+#define	NI4050_FILTER_RATE_MHZ(code)	(19200000 / (code))
+
+// Functions the driver can autorange
+#define	NI4050_AUTORANGE_OFF		0
+#define	NI4050_AUTORANGE_VDC		1
+#define	NI4050_AUTORANGE_VAC		2
+#define	NI4050_AUTORANGE_OHMS		3
+#define	NI4050_AUTORANGE_FUNCTIONS	4
+
+// Argument of NIDMM_IOCSETAUTORANGE, an explicit NIDMM_IOCSTARTMEASUREMENT
+// turns autoranging off again.
+//
+// The driver steps one range up on an overflow or when a reading exceeds
+// upPermille of the full scale, and one range down when it is below
+// downPermille of the full scale of the next lower range. The conversions
+// after a switch are discarded until the filter has settled, the range
+// field of every NI4050Sample tells which range it was measured in.
+typedef struct
+{
+	__u32 function;			// NI4050_AUTORANGE_*
+	__u32 upPermille;		// 0 for NI4050_AUTORANGE_UP_DEFAULT
+	__u32 downPermille;		// 0 for NI4050_AUTORANGE_DOWN_DEFAULT, below upPermille
+	__u32 settleSamples;	// discarded after a switch, 0 for NI4050_AUTORANGE_SETTLE_DEFAULT
+} NI4050Autorange;
+
+#define	NI4050_AUTORANGE_UP_DEFAULT		950
+#define	NI4050_AUTORANGE_DOWN_DEFAULT	800
+#define	NI4050_AUTORANGE_SETTLE_DEFAULT	3
+
+// Cost of the last NIDMM_IOCSTARTMEASUREMENT
+typedef struct
+{
+	__u32 portIO;			// inb/outb issued, ADC ready polling included
+	__u32 registerWrites;	// writes of the programming sequence
+	__u32 fullReset;		// 1 if the ADC was reset, 0 for a delta update
+} NI4050SwitchStats;
+
+
+#define	NI4050_GROUP_MAX	4
+
+// Argument of NIDMM_IOCGROUPSTART, which starts several cards in step.
+//
+// Every card is programmed for its range first, then the filters of all
+// of them are released back to back with the interrupts off. From there
+// the conversions run at the rate of each card's filter and drift apart
+// only as much as the card clocks do. The cards must be on the same
+// NIDMM_IOCSETCLOCK clock, started[] tells how far apart they began.
+typedef struct
+{
+	__u32 count;					// cards in the group
+	__u32 reserved;
+	__s32 fd[NI4050_GROUP_MAX];		// open nidmm descriptors
+	__s32 range[NI4050_GROUP_MAX];	// NI4050_RANGES of each card
+	__u64 started[NI4050_GROUP_MAX];	// out: timestamp of each filter release
+} NI4050GroupStart;
+
+// Number of samples buffered per device for the readers, power of 2
+#define	NI4050_FIFO_SAMPLES	1024
+
+// A card may be opened any number of times. The descriptor opened for
+// writing is the controller, there is only one at a time and a second one
+// fails with EBUSY. Read-only descriptors are subscribers: read(),
+// NIDMM_IOCREADRAW and NIDMM_IOCREADSAMPLES give them every conversion the
+// driver reads from the card from the open on, whatever mode the controller
+// runs, each from its own position. One which falls more than
+// NI4050_FIFO_SAMPLES behind loses the oldest records and counts them in
+// NIDMM_IOCGETOVERRUNS, nobody waits for it. The calls which change the
+// card fail with EPERM on a subscriber.
 
 #define	NIDMM_IOC_MAXNR	        255
 #define NIDMM_IOC_MAGIC 		'n'
@@ -45,7 +246,30 @@ typedef enum _NI4050_RANGES
 #define	NIDMM_IOCEEPROMWRITE				_IOW (NIDMM_IOC_MAGIC, 2, EEPROMInfo *)
 #define	NIDMM_IOCEEPROMREADINTRES			_IOR (NIDMM_IOC_MAGIC, 3, unsigned int *)
 #define NIDMM_IOCSTARTMEASUREMENT			_IOW (NIDMM_IOC_MAGIC, 4, NI4050_RANGES *)
-#define NIDMM_IOCREADDATA					_IOR (NIDMM_IOC_MAGIC, 5, double *)
+// replaced by NIDMM_IOCREADRAW, the conversion is done in userspace
+//#define NIDMM_IOCREADDATA					_IOR (NIDMM_IOC_MAGIC, 5, double *)
+#define NIDMM_IOCSETCONTINUOUS				_IOW (NIDMM_IOC_MAGIC, 6, NI4050ContinuousMode *)
+// records this descriptor lost since it was opened or, for the controller,
+// since continuous mode was turned on
+#define NIDMM_IOCGETOVERRUNS				_IOR (NIDMM_IOC_MAGIC, 7, unsigned int *)
+// re-read the cached EEPROM image and the calibration constants, takes
+// effect on the next start
+#define NIDMM_IOCRELOADCALIBRATION			_IO (NIDMM_IOC_MAGIC, 8)
+#define NIDMM_IOCGETSWITCHSTATS				_IOR (NIDMM_IOC_MAGIC, 9, NI4050SwitchStats *)
+// NIDMM_IOCREADSAMPLES and NIDMM_IOCREADRAW fail with EAGAIN on an O_NONBLOCK
+// descriptor when no conversion is ready, poll() reports POLLIN once there
+// is one and POLLERR after the card was removed
+#define NIDMM_IOCREADSAMPLES				_IOWR (NIDMM_IOC_MAGIC, 10, NI4050SampleBatch *)
+#define NIDMM_IOCGETSCALE					_IOWR (NIDMM_IOC_MAGIC, 11, NI4050Scale *)
+#define NIDMM_IOCREADRAW					_IOR (NIDMM_IOC_MAGIC, 12, unsigned int *)
+// CLOCK_MONOTONIC (default), CLOCK_BOOTTIME or CLOCK_TAI
+#define NIDMM_IOCSETCLOCK					_IOW (NIDMM_IOC_MAGIC, 13, int *)
+#define NIDMM_IOCSETFILTER					_IOWR (NIDMM_IOC_MAGIC, 14, NI4050Filter *)
+#define NIDMM_IOCSETAUTORANGE				_IOW (NIDMM_IOC_MAGIC, 15, NI4050Autorange *)
+// may be issued on any descriptor, the cards are named in the argument by
+// the descriptors of their controllers
+#define NIDMM_IOCGROUPSTART					_IOWR (NIDMM_IOC_MAGIC, 16, NI4050GroupStart *)
+#define NIDMM_IOCEEPROMREADBLOCK			_IOWR (NIDMM_IOC_MAGIC, 17, NI4050EepromBlock *)
 
 
 /* card and device states */
@@ -71,28 +295,135 @@ typedef enum _NI4050_RANGES
 
 // These values are used in the conversion from binary
 // values to engineering units. These are the actual 
-// unipolar ranges of the ADC
+// unipolar ranges of the ADC. They are computed from the integer
+// fractions below, so the driver and userspace can not disagree.
+
+#define NI4050_CONVERT_RANGE_FRACTION(scale) \
+	((double)NI4050_CONVERT_RANGE_##scale##_NUM / NI4050_CONVERT_RANGE_##scale##_DEN)
 
-#define NI4050_CONVERT_RANGE_250VDC             250.0
-#define NI4050_CONVERT_RANGE_25VDC              31.25
-#define NI4050_CONVERT_RANGE_2VDC               2.5
-#define NI4050_CONVERT_RANGE_200mVDC            0.3125
-#define NI4050_CONVERT_RANGE_20mVDC             0.0390625
+#define NI4050_CONVERT_RANGE_250VDC             NI4050_CONVERT_RANGE_FRACTION(250VDC)
+#define NI4050_CONVERT_RANGE_25VDC              NI4050_CONVERT_RANGE_FRACTION(25VDC)
+#define NI4050_CONVERT_RANGE_2VDC               NI4050_CONVERT_RANGE_FRACTION(2VDC)
+#define NI4050_CONVERT_RANGE_200mVDC            NI4050_CONVERT_RANGE_FRACTION(200mVDC)
+#define NI4050_CONVERT_RANGE_20mVDC             NI4050_CONVERT_RANGE_FRACTION(20mVDC)
 
-#define NI4050_CONVERT_RANGE_250VAC             250.0
-#define NI4050_CONVERT_RANGE_25VAC              31.25
-#define NI4050_CONVERT_RANGE_2VAC               3.125
-#define NI4050_CONVERT_RANGE_200mVAC            0.3125
-#define NI4050_CONVERT_RANGE_20mVAC             0.03125
+#define NI4050_CONVERT_RANGE_250VAC             NI4050_CONVERT_RANGE_FRACTION(250VAC)
+#define NI4050_CONVERT_RANGE_25VAC              NI4050_CONVERT_RANGE_FRACTION(25VAC)
+#define NI4050_CONVERT_RANGE_2VAC               NI4050_CONVERT_RANGE_FRACTION(2VAC)
+#define NI4050_CONVERT_RANGE_200mVAC            NI4050_CONVERT_RANGE_FRACTION(200mVAC)
+#define NI4050_CONVERT_RANGE_20mVAC             NI4050_CONVERT_RANGE_FRACTION(20mVAC)
 
+// the EXTOHM row converts with the 2MOHM fraction and linearizes
 #define NI4050_CONVERT_RANGE_EXTOHM             200000000.0
-#define NI4050_CONVERT_RANGE_2MOHM              2500000.0
-#define NI4050_CONVERT_RANGE_200kOHM            312500.0
-#define NI4050_CONVERT_RANGE_20kOHM             25000
-#define NI4050_CONVERT_RANGE_2kOHM              3125
-#define NI4050_CONVERT_RANGE_200OHM             390.625
+#define NI4050_CONVERT_RANGE_2MOHM              NI4050_CONVERT_RANGE_FRACTION(2MOHM)
+#define NI4050_CONVERT_RANGE_200kOHM            NI4050_CONVERT_RANGE_FRACTION(200kOHM)
+#define NI4050_CONVERT_RANGE_20kOHM             NI4050_CONVERT_RANGE_FRACTION(20kOHM)
+#define NI4050_CONVERT_RANGE_2kOHM              NI4050_CONVERT_RANGE_FRACTION(2kOHM)
+#define NI4050_CONVERT_RANGE_200OHM             NI4050_CONVERT_RANGE_FRACTION(200OHM)
+
+#define NI4050_CONVERT_RANGE_DIODE              NI4050_CONVERT_RANGE_FRACTION(DIODE)
+
+// The same ranges as integer fractions, used by the driver which
+// must not touch floating point
+
+#define NI4050_CONVERT_CODE_ZERO                0x7fffff
+#define NI4050_CONVERT_CODE_SPAN                0x7fffff
+
+#define NI4050_CONVERT_RANGE_250VDC_NUM         250
+#define NI4050_CONVERT_RANGE_250VDC_DEN         1
+#define NI4050_CONVERT_RANGE_25VDC_NUM          125
+#define NI4050_CONVERT_RANGE_25VDC_DEN          4
+#define NI4050_CONVERT_RANGE_2VDC_NUM           5
+#define NI4050_CONVERT_RANGE_2VDC_DEN           2
+#define NI4050_CONVERT_RANGE_200mVDC_NUM        5
+#define NI4050_CONVERT_RANGE_200mVDC_DEN        16
+#define NI4050_CONVERT_RANGE_20mVDC_NUM         5
+#define NI4050_CONVERT_RANGE_20mVDC_DEN         128
+
+#define NI4050_CONVERT_RANGE_250VAC_NUM         250
+#define NI4050_CONVERT_RANGE_250VAC_DEN         1
+#define NI4050_CONVERT_RANGE_25VAC_NUM          125
+#define NI4050_CONVERT_RANGE_25VAC_DEN          4
+#define NI4050_CONVERT_RANGE_2VAC_NUM           25
+#define NI4050_CONVERT_RANGE_2VAC_DEN           8
+#define NI4050_CONVERT_RANGE_200mVAC_NUM        5
+#define NI4050_CONVERT_RANGE_200mVAC_DEN        16
+#define NI4050_CONVERT_RANGE_20mVAC_NUM         1
+#define NI4050_CONVERT_RANGE_20mVAC_DEN         32
+
+#define NI4050_CONVERT_RANGE_2MOHM_NUM          2500000
+#define NI4050_CONVERT_RANGE_2MOHM_DEN          1
+#define NI4050_CONVERT_RANGE_200kOHM_NUM        312500
+#define NI4050_CONVERT_RANGE_200kOHM_DEN        1
+#define NI4050_CONVERT_RANGE_20kOHM_NUM         25000
+#define NI4050_CONVERT_RANGE_20kOHM_DEN         1
+#define NI4050_CONVERT_RANGE_2kOHM_NUM          3125
+#define NI4050_CONVERT_RANGE_2kOHM_DEN          1
+#define NI4050_CONVERT_RANGE_200OHM_NUM         3125
+#define NI4050_CONVERT_RANGE_200OHM_DEN         8
+
+#define NI4050_CONVERT_RANGE_DIODE_NUM          5
+#define NI4050_CONVERT_RANGE_DIODE_DEN          2
+
+#ifndef __KERNEL__
+// Engineering units per code of a linear range
+static inline double ni4050ScaleFactor(const NI4050Scale *scale)
+{
+	return (double)scale->scaleNum / ((double)scale->scaleDen * scale->codeSpan);
+}
 
-#define NI4050_CONVERT_RANGE_DIODE              2.5
+// Convert a raw code to engineering units with the scale from NIDMM_IOCGETSCALE
+static inline double ni4050ConvertRaw(const NI4050Scale *scale, unsigned int code)
+{
+	double x = (double)((int)code - (int)scale->zeroCode) * ni4050ScaleFactor(scale);
+
+	if (scale->flags & NI4050_SCALE_EXTOHM)
+		x = x * scale->intResistance / (scale->intResistance - x);
+
+	return x;
+}
+
+// Copy up to count records out of a mapped ring. With
+// NI4050_OVERRUN_DROP_OLDEST the driver may overwrite records which have
+// not been consumed yet, those are skipped and reported through lost.
+static inline unsigned int ni4050RingRead(volatile NI4050RingHeader *ring,
+		NI4050Sample *samples, unsigned int count, unsigned long long *lost)
+{
+	const NI4050Sample *records = (const NI4050Sample *)((const char *)ring + ring->recordOffset);
+	unsigned long long head, tail = ring->tail;
+	unsigned int i, j, n;
+
+	head = ring->head;
+	__sync_synchronize();	// records are read after head
+
+	if (head - tail > ring->capacity) {
+		*lost += head - tail - ring->capacity;
+		tail = head - ring->capacity;
+	}
+
+	n = head - tail < count ? head - tail : count;
+	for (i = 0; i < n; i++)
+		samples[i] = records[(tail + i) & (ring->capacity - 1)];
+
+	// the driver may have lapped us while we were copying, the slot of
+	// the record after head may be half written
+	__sync_synchronize();
+	head = ring->head;
+	if (head - tail >= ring->capacity) {
+		i = head - tail - ring->capacity + 1;
+		if (i > n)
+			i = n;
+		*lost += i;
+		n -= i;
+		for (j = 0; j < n; j++)
+			samples[j] = samples[j + i];
+		tail += i;
+	}
+
+	ring->tail = tail + n;
+	return n;
+}
+#endif	/* __KERNEL__ */
 
 
 // Default value of internal resistor and its limits
@@ -213,6 +544,9 @@ typedef enum _NI4050_RANGES
 #define NI4050_ADC_WRITE_FILTERHIGH_50HZ           0x61
 #define NI4050_ADC_WRITE_FILTERHIGH_60HZ           0x61
 
+// Bipolar, 24 bit word length and boost on top of FS11..FS8
+#define NI4050_ADC_WRITE_FILTERHIGH_FLAGS          0x60
+
 // ADC Write Register Bits - Filter Low Register
 
 #define NI4050_ADC_WRITE_FILTERLOW_10HZ            0x80
@@ -263,6 +597,12 @@ typedef enum _NI4050_RANGES
 #define NI4050_EEPROM_AREA_USER                 0x0400
 #define NI4050_EEPROM_AREA_LOAD                 0x0800
 #define NI4050_EEPROM_AREA_FACTORY              0x0C00
+#define NI4050_EEPROM_SIZE                      0x1000
+
+// The blocks are laid out one after the other, an offset is the sum of
+// mode, range and filter, not their bitwise or
+#define NI4050_EEPROM_OFFSET(mode, range, filter) \
+	(NI4050_EEPROM_MODE_##mode + NI4050_EEPROM_RANGE_##range + NI4050_EEPROM_FILTER_##filter)
 
 #define NI4050_EEPROM_MODE_VDC                  0x0000
 #define NI4050_EEPROM_MODE_VAC                  0x00A0
@@ -282,6 +622,7 @@ typedef enum _NI4050_RANGES
 #define NI4050_EEPROM_RANGE_20kOHM              0x40
 #define NI4050_EEPROM_RANGE_2kOHM               0x60
 #define NI4050_EEPROM_RANGE_200OHM              0x80
+#define NI4050_EEPROM_RANGE_DIODE               0x00
 
 #define NI4050_EEPROM_FILTER_10HZ               0x00
 #define NI4050_EEPROM_FILTER_50HZ               0x06
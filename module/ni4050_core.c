@@ -0,0 +1,589 @@
+/*
+  * Hardware independent part of the NI4050 driver
+  *
+  * ni4050_core.c
+  *
+  * Written by Miklós Márton martonmiklosqdev@gmail.com according to the
+  * provided MHDDK Windows CE example provided by the NI here:
+  * https://lumen.ni.com/nicif/us/evalmhddk/content.xhtml
+  * All rights reserved. Licensed under LGPL license.
+  */
+
+#include "ni4050_core.h"
+
+#define MEASUREMENT_DATA(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+		acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+	[NI4050_RANGE_##range] = { \
+		NI4050_RANGE_##range, \
+		NI4050_EEPROM_OFFSET(eepromMode, eepromRange, calFilter), \
+		NI4050_CONFIG_I_R_##inputRange, \
+		NI4050_CONFIG_OHMS_##ohmsMode, \
+		NI4050_CONFIG_AC_R_##acRange, \
+		NI4050_CONFIG_O_R_##ohmsRange, \
+		NI4050_ADC_COMMAND_MODE_##adcMode, \
+		NI4050_ADC_WRITE_GAIN_##range, \
+		NI4050_ADC_WRITE_FILTERHIGH_##filter, \
+		NI4050_ADC_WRITE_FILTERLOW_##filter, \
+		NI4050_CONVERT_RANGE_##scale##_NUM, \
+		NI4050_CONVERT_RANGE_##scale##_DEN, \
+		flags \
+	},
+
+// indexed by NI4050_RANGES
+MeasurementData measurmentInfo[NI4050_RANGE_COUNT] =
+{
+	NI4050_RANGE_TABLE(MEASUREMENT_DATA)
+};
+
+static const FilterPreset filterPresets[NI4050_FILTER_PRESETS] =
+{
+	[NI4050_FILTER_10HZ] = { NI4050_ADC_WRITE_FILTERHIGH_10HZ, NI4050_ADC_WRITE_FILTERLOW_10HZ, NI4050_EEPROM_FILTER_10HZ },
+	[NI4050_FILTER_50HZ] = { NI4050_ADC_WRITE_FILTERHIGH_50HZ, NI4050_ADC_WRITE_FILTERLOW_50HZ, NI4050_EEPROM_FILTER_50HZ },
+	[NI4050_FILTER_60HZ] = { NI4050_ADC_WRITE_FILTERHIGH_60HZ, NI4050_ADC_WRITE_FILTERLOW_60HZ, NI4050_EEPROM_FILTER_60HZ },
+};
+
+unsigned char readEEPROM(struct ni4050_core *core, unsigned int address) 
+{
+	unsigned char ret = 0;
+	ni4050_coreOutb(core, (address >> 8) & 0xFF, NI4050_EEPROM_ADDR2_REG);
+	ni4050_coreOutb(core, (address) & 0xFF, NI4050_EEPROM_ADDR1_REG);
+	ret = ni4050_coreInb(core, NI4050_EEPROM_DATA_REG);
+	return ret;
+}
+
+// Read 3-byte EEPROM value (calibration coefficient) from
+// the specified EEPROM address offset
+int readEEPROMWord(struct ni4050_core *core, unsigned int address) 
+{
+	int i = 0, ret = 0;
+
+	for (;i<3;i++)
+	{
+		ret += (readEEPROM(core, (address + i)) << (8*i));
+	}
+
+	return ret;
+}
+
+// Copy the whole EEPROM into core->eeprom. The high address byte is only
+// written when it changes, two port accesses per byte.
+void loadEeprom(struct ni4050_core *core)
+{
+	unsigned int address;
+
+	core->eepromValid = 0;
+	for (address = 0; address < NI4050_EEPROM_SIZE; address++)
+	{
+		if ((address & 0xFF) == 0)
+			ni4050_coreOutb(core, (address >> 8) & 0xFF, NI4050_EEPROM_ADDR2_REG);
+		ni4050_coreOutb(core, address & 0xFF, NI4050_EEPROM_ADDR1_REG);
+		core->eeprom[address] = ni4050_coreInb(core, NI4050_EEPROM_DATA_REG);
+	}
+	core->eepromValid = 1;
+}
+
+// 3-byte value of the EEPROM image
+static int eepromWord(struct ni4050_core *core, unsigned int address)
+{
+	return core->eeprom[address] | (core->eeprom[address + 1] << 8) |
+		(core->eeprom[address + 2] << 16);
+}
+
+void setWriteEEPROMEnable(struct ni4050_core *core, unsigned char enabled)
+{
+	unsigned char tmp = 0;
+	if (enabled) {
+		tmp = ni4050_coreInb(core, NI4050_COMMAND_REG);
+		tmp |= NI4050_COMMAND_EEPROM_WE;
+		ni4050_coreOutb(core, tmp, NI4050_COMMAND_REG);
+	} else {
+		tmp = ni4050_coreInb(core, NI4050_COMMAND_REG);
+		tmp &= ~NI4050_COMMAND_EEPROM_WE;
+		ni4050_coreOutb(core, tmp, NI4050_COMMAND_REG);
+	}
+}
+
+/*static unsigned char writeEEPROM(struct ni4050_core *core, unsigned int address, unsigned char data) 
+{
+
+	//check to see if EEPROM offset is within allowed range
+	if (address >= 0x300 && address < 0x400)
+	{
+		setWriteEEPROMEnable(core, 1);
+
+		ni4050_coreOutb(core, (address >> 8) & 0xFF, NI4050_EEPROM_ADDR2_REG);
+		ni4050_coreOutb(core, (address) & 0xFF, NI4050_EEPROM_ADDR1_REG);
+		ni4050_coreOutb(core, data, NI4050_EEPROM_DATA_REG);
+
+		setWriteEEPROMEnable(core, 0);
+
+		pr_debug("writeEEPROM 0x%04x t0x%02x\n", address, data);
+	}
+	else
+	{
+		pr_debug("Error writing to EEPROM: invalid address: 0x%04x.\n", address);
+		return -1;
+	}
+
+	return 0;
+}*/
+
+// Check if ADC is ready for the next write operation
+int adcReady(struct ni4050_core *core)
+{
+	return (int) (ni4050_inb(core, NI4050_COMMAND_REG) & NI4050_STATUS_ADC_RDY);
+};
+
+
+// Loops on adcReady until it gets ready, sleeps only if it is not
+int waitForAdcReady(struct ni4050_core *core)
+{
+	unsigned int timeOutCounter = 0;
+	while (!adcReady(core)) {
+		ni4050_coreDelay(core, 1);
+		timeOutCounter++;
+		if (timeOutCounter == NI4050_ADC_READY_TIMEOUT_MS) {
+			core->adcTimeouts++;
+			return -1;
+		}
+	}
+	return 0;
+};
+
+// Take the actual internal resistor value from the EEPROM image
+int eepromReadResistance(struct ni4050_core *core)
+{
+	core->dIntResistorValue = eepromWord(core, NI4050_EEPROM_AREA_LOAD | NI4050_EEPROM_INTERNAL_RESISTANCE);
+
+	pr_debug("ni 4050 internal resistance: %d Ohm\n", core->dIntResistorValue);
+
+	if ( (core->dIntResistorValue < NI4050_INTERNAL_RESISTANCE_SPEC_MIN / 5 * 4) ||
+		 (core->dIntResistorValue > NI4050_INTERNAL_RESISTANCE_SPEC_MAX / 5 * 6) )
+	{
+		pr_debug("ni 4050 internal resistance: %d is out of range\n \
+			   not between %d and %d\n",
+			   core->dIntResistorValue,
+			   NI4050_INTERNAL_RESISTANCE_SPEC_MIN,
+			   NI4050_INTERNAL_RESISTANCE_SPEC_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void sequenceAdd(ProgrammingSequence *seq, unsigned char reg, unsigned char value)
+{
+	seq->writes[seq->length].reg = reg;
+	seq->writes[seq->length].value = value;
+	seq->length++;
+}
+
+static void sequenceAddCoeff(ProgrammingSequence *seq, unsigned char regSel, int coeff)
+{
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG, regSel | NI4050_ADC_COMMAND_DEFAULT | NI4050_ADC_WRITE_FSYNCH);
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, (unsigned char)(coeff >> 16));
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, (unsigned char)(coeff >> 8));
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, (unsigned char)(coeff));
+}
+
+// Compile the register writes which set up measurmentInfo[i]
+static void buildSequence(struct ni4050_core *core, unsigned int i)
+{
+	ProgrammingSequence *seq = &core->sequence[i];
+	MeasurementData *info = &measurmentInfo[i];
+	FilterSetting *filter = &core->filter[i];
+	CalibrationData *cal = &core->cal[i][filter->preset];
+
+	seq->family = (info->measurmentMode << 8) | info->ohmsMode;
+	seq->length = 0;
+
+	// Set Config Register
+	seq->groupStart[SEQUENCE_CONFIG] = seq->length;
+	sequenceAdd(seq, NI4050_CONFIG_REG,
+		info->inputRange | info->ohmsMode | info->acRange | info->ohmsRange);
+
+	// Set ADC Mode, keep the filter in reset
+	seq->groupStart[SEQUENCE_MODE] = seq->length;
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG,
+		info->measurmentMode | NI4050_ADC_COMMAND_REGSEL_MODEREG | NI4050_ADC_COMMAND_DEFAULT);
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, 1 | info->gain);
+
+	// Set Filter Frequency
+	seq->groupStart[SEQUENCE_FILTER] = seq->length;
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG,
+		NI4050_ADC_COMMAND_REGSEL_FILTERHIGH | NI4050_ADC_COMMAND_DEFAULT | NI4050_ADC_WRITE_FSYNCH);
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, filter->filterValueH);
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG,
+		NI4050_ADC_COMMAND_REGSEL_FILTERLOW | NI4050_ADC_COMMAND_DEFAULT | NI4050_ADC_WRITE_FSYNCH);
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, filter->filterValueL);
+
+	// Set Calibration Coefficients
+	seq->groupStart[SEQUENCE_ZEROCAL] = seq->length;
+	sequenceAddCoeff(seq, NI4050_ADC_COMMAND_REGSEL_ZEROCALIB, cal->zeroScale);
+	seq->groupStart[SEQUENCE_FULLCAL] = seq->length;
+	sequenceAddCoeff(seq, NI4050_ADC_COMMAND_REGSEL_FULLCALIB, cal->fullScale);
+
+	// Set Mode and Start Modulator/Filter, then set card to read
+	seq->groupStart[SEQUENCE_START] = seq->length;
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG, info->measurmentMode |
+		NI4050_ADC_COMMAND_REGSEL_MODEREG | NI4050_ADC_COMMAND_DEFAULT | NI4050_ADC_WRITE_FSYNCH);
+	sequenceAdd(seq, NI4050_ADC_WRITE_REG, info->gain);
+	sequenceAdd(seq, NI4050_ADC_COMMAND_REG, info->measurmentMode | NI4050_ADC_COMMAND_REGSEL_DATAREG |
+		NI4050_ADC_COMMAND_READ | NI4050_ADC_COMMAND_DEFAULT | NI4050_ADC_WRITE_FSYNCH);
+
+	seq->groupStart[SEQUENCE_GROUPS] = seq->length;
+}
+
+static int sequenceGroupEqual(const ProgrammingSequence *a, const ProgrammingSequence *b, int group)
+{
+	unsigned int start = a->groupStart[group];
+	unsigned int length = a->groupStart[group + 1] - start;
+
+	if (b->groupStart[group] != start || b->groupStart[group + 1] - start != length)
+		return 0;
+
+	return !memcmp(&a->writes[start], &b->writes[start], length * sizeof(RegisterWrite));
+}
+
+// Read the EEPROM image and take the internal resistance and the
+// calibration constants of every measurement from it, so range switches
+// do not touch the EEPROM
+int loadCalibration(struct ni4050_core *core)
+{
+	unsigned int i, preset, base, EEPROMAddress;
+	CalibrationData *cal;
+
+	core->calibrationValid = 0;
+	loadEeprom(core);
+	if (eepromReadResistance(core))
+		return -1;
+
+	for (i = 0; i < NI4050_MEASUREMENT_COUNT; i++)
+	{
+		base = NI4050_EEPROM_AREA_LOAD + (measurmentInfo[i].calConstantOffset & ~NI4050_EEPROM_FILTER_MASK);
+
+		for (preset = 0; preset < NI4050_FILTER_PRESETS; preset++)
+		{
+			cal = &core->cal[i][preset];
+
+			EEPROMAddress = base + filterPresets[preset].calOffset + NI4050_EEPROM_CAL_ZERO;
+			cal->zeroScale = eepromWord(core, EEPROMAddress);
+
+			EEPROMAddress = base + filterPresets[preset].calOffset + NI4050_EEPROM_CAL_FULL;
+			cal->fullScale = eepromWord(core, EEPROMAddress);
+
+			pr_debug("Calibration %d filter %d zero scale: %d full scale: %d\n",
+				   measurmentInfo[i].range, preset, cal->zeroScale, cal->fullScale);
+		}
+
+		buildSequence(core, i);
+	}
+
+	core->calibrationValid = 1;
+	return 0;
+}
+
+// Row of measurmentInfo[] describing a range, -1 if it is not supported
+int findMeasurement(NI4050_RANGES range)
+{
+	if (range < 0 || range >= NI4050_MEASUREMENT_COUNT)
+		return -1;
+
+	return range;
+}
+
+// COMMAND_REG value while a measurement runs, startMeasurmentPrepare()
+// turns the conversion interrupt off and startMeasurmentFinish() back on
+void initCommand(struct ni4050_core *core, int irq)
+{
+	core->command = irq ? NI4050_COMMAND_ADCINTEN : NI4050_COMMAND_DEFAULT;
+}
+
+// Filter and calibration set the measurmentInfo[] rows come with
+void initFilters(struct ni4050_core *core)
+{
+	unsigned int i, preset;
+
+	for (i = 0; i < NI4050_MEASUREMENT_COUNT; i++)
+	{
+		core->filter[i].filterValueH = measurmentInfo[i].filterValueH;
+		core->filter[i].filterValueL = measurmentInfo[i].filterValueL;
+		core->filter[i].preset = NI4050_FILTER_10HZ;
+
+		for (preset = 0; preset < NI4050_FILTER_PRESETS; preset++)
+			if (filterPresets[preset].calOffset ==
+				(measurmentInfo[i].calConstantOffset & NI4050_EEPROM_FILTER_MASK))
+				core->filter[i].preset = preset;
+	}
+}
+
+static int filterCode(unsigned char filterValueH, unsigned char filterValueL)
+{
+	return ((filterValueH & 0x0F) << 8) | filterValueL;
+}
+
+// Choose the filter of a measurement, applied by its next startMeasurment()
+int setFilter(struct ni4050_core *core, NI4050Filter *filter)
+{
+	FilterSetting *setting;
+	unsigned int preset, best = 0;
+	int i, code;
+
+	i = findMeasurement(filter->range);
+	if (i < 0 || filter->preset >= NI4050_FILTER_PRESETS)
+		return -EINVAL;
+
+	setting = &core->filter[i];
+	code = filter->filterCode;
+	if (code == 0)
+	{
+		setting->filterValueH = filterPresets[filter->preset].filterValueH;
+		setting->filterValueL = filterPresets[filter->preset].filterValueL;
+		setting->preset = filter->preset;
+	}
+	else
+	{
+		if (code < NI4050_FILTER_CODE_MIN || code > NI4050_FILTER_CODE_MAX)
+			return -EINVAL;
+
+		setting->filterValueH = NI4050_ADC_WRITE_FILTERHIGH_FLAGS | (code >> 8);
+		setting->filterValueL = code & 0xFF;
+
+		// calibrate with the preset of the nearest filter word
+		for (preset = 1; preset < NI4050_FILTER_PRESETS; preset++)
+			if (abs(filterCode(filterPresets[preset].filterValueH, filterPresets[preset].filterValueL) - code) <
+				abs(filterCode(filterPresets[best].filterValueH, filterPresets[best].filterValueL) - code))
+				best = preset;
+		setting->preset = best;
+	}
+
+	filter->filterCode = filterCode(setting->filterValueH, setting->filterValueL);
+	filter->preset = setting->preset;
+	filter->rateMilliHz = NI4050_FILTER_RATE_MHZ(filter->filterCode);
+
+	if (core->calibrationValid)
+		buildSequence(core, i);
+	return 0;
+}
+
+int measurmentIsReady(struct ni4050_core *core)
+{
+	unsigned char ret = ni4050_coreInb(core, NI4050_STATUS_REG);
+	if (ret & NI4050_STATUS_OVERFLOW)
+	{
+		pr_debug("Overflow\n");
+	}
+	
+	// the whole status byte is handed back with the sample
+	return (ret & NI4050_STATUS_NEW_DATA) ? ret : 0;
+}
+
+// Read the 3-byte conversion result registers
+int measurmentDataRegsRead(struct ni4050_core *core)
+{
+	int i, value = 0;
+
+	for (i = 0; i<3; i++)
+	{
+		value += (ni4050_coreInb(core, NI4050_ADC_DATA1_REG + i) << (8*i));
+	}
+
+	return value;
+}
+
+// Describe how userspace turns the raw codes of a range into engineering units
+int getConvertScale(struct ni4050_core *core, NI4050Scale *scale)
+{
+	int range = scale->range;
+
+	if (range == NI4050_RANGE_INVALID)
+		range = core->measurmentMode;
+
+	if (findMeasurement(range) < 0)
+		return -EINVAL;
+
+	scale->range = range;
+	scale->zeroCode = NI4050_CONVERT_CODE_ZERO;
+	scale->codeSpan = NI4050_CONVERT_CODE_SPAN;
+	scale->scaleNum = measurmentInfo[range].scaleNum;
+	scale->scaleDen = measurmentInfo[range].scaleDen;
+	scale->intResistance = core->dIntResistorValue;
+	scale->flags = measurmentInfo[range].scaleFlags;
+	scale->reserved = 0;
+	return 0;
+}
+
+const NI4050_RANGES autorangeLadder[NI4050_AUTORANGE_FUNCTIONS][6] =
+{
+	[NI4050_AUTORANGE_OFF]	= { NI4050_RANGE_INVALID },
+	[NI4050_AUTORANGE_VDC]	= { NI4050_RANGE_250VDC, NI4050_RANGE_25VDC, NI4050_RANGE_2VDC,
+								NI4050_RANGE_200mVDC, NI4050_RANGE_20mVDC, NI4050_RANGE_INVALID },
+	[NI4050_AUTORANGE_VAC]	= { NI4050_RANGE_250VAC, NI4050_RANGE_25VAC, NI4050_RANGE_2VAC,
+								NI4050_RANGE_200mVAC, NI4050_RANGE_20mVAC, NI4050_RANGE_INVALID },
+	[NI4050_AUTORANGE_OHMS]	= { NI4050_RANGE_2MOHM, NI4050_RANGE_200kOHM, NI4050_RANGE_20kOHM,
+								NI4050_RANGE_2kOHM, NI4050_RANGE_200OHM, NI4050_RANGE_INVALID },
+};
+
+// Range the autorange wants for a conversion, the conversion's own one if
+// it reads fine
+NI4050_RANGES autorangeNext(const NI4050Autorange *autorange, const NI4050Sample *sample)
+{
+	const NI4050_RANGES *ladder = autorangeLadder[autorange->function];
+	const MeasurementData *cur, *low;
+	int pos;
+	u64 mag;
+
+	for (pos = 0; ladder[pos] != NI4050_RANGE_INVALID; pos++)
+		if (ladder[pos] == sample->range)
+			break;
+	if (ladder[pos] == NI4050_RANGE_INVALID)
+		return sample->range;
+
+	mag = abs((int)sample->value - NI4050_CONVERT_CODE_ZERO);
+
+	if (pos > 0 && ((sample->status & NI4050_STATUS_OVERFLOW) ||
+			mag * 1000 > (u64)autorange->upPermille * NI4050_CONVERT_CODE_SPAN))
+		return ladder[pos - 1];
+
+	if (ladder[pos + 1] != NI4050_RANGE_INVALID) {
+		// compare with the full scale of the lower range in codes of this one
+		cur = &measurmentInfo[sample->range];
+		low = &measurmentInfo[ladder[pos + 1]];
+		if (mag * 1000 * cur->scaleNum * low->scaleDen <
+			(u64)autorange->downPermille * NI4050_CONVERT_CODE_SPAN * low->scaleNum * cur->scaleDen)
+			return ladder[pos + 1];
+	}
+
+	return sample->range;
+}
+
+// Program the ADC for a measurement, all but releasing the filter. Within
+// the same measurement family only the register groups which differ from
+// the live state are written. The card is left ready for
+// startMeasurmentFire().
+int startMeasurmentPrepare(struct ni4050_core *core, NI4050_RANGES measurementMode)
+{
+	ProgrammingSequence *seq;
+	RegisterWrite *w;
+	int replay[SEQUENCE_GROUPS];
+	unsigned int writes = 0;
+	int i, fullReset, group;
+
+	pr_debug("-> startMeasurment mode: %d\n", measurementMode);
+
+	core->armed = NULL;
+	i = findMeasurement(measurementMode);
+	if (i < 0)
+	{
+		pr_debug("Measurement mode: %d is not yet supported\n", measurementMode);
+		return -1;
+	}
+
+	pr_debug("startMeasurment mode found: %d\n", i);
+	if (!core->calibrationValid)
+		return -1;
+
+	core->measurmentMode = measurementMode;
+	core->ZeroScaleCalCoeff = core->cal[i][core->filter[i].preset].zeroScale;
+	core->FullScaleCalCoeff = core->cal[i][core->filter[i].preset].fullScale;
+
+	seq = &core->sequence[i];
+	fullReset = !core->liveValid || core->live.family != seq->family;
+	core->liveValid = 0;
+	core->ioCount = 0;
+
+	if (fullReset) {
+		// Reset registers to known state
+		pr_debug("// Reset registers to known state\n");
+		ni4050_outb(core, 0x00, NI4050_COMMAND_REG);
+		ni4050_outb(core, NI4050_ADC_COMMAND_DEFAULT, NI4050_ADC_COMMAND_REG);
+		ni4050_outb(core, 0x00, NI4050_ADC_WRITE_REG);
+		ni4050_outb(core, 0x00, NI4050_CONFIG_REG);
+
+		// Reset board
+		ni4050_outb(core, NI4050_ADC_COMMAND_RESET, NI4050_ADC_COMMAND_REG);
+	} else if (core->command) {
+		// no interrupts while the ADC is reprogrammed
+		ni4050_outb(core, NI4050_COMMAND_DEFAULT, NI4050_COMMAND_REG);
+	}
+
+	for (group = 0; group < SEQUENCE_GROUPS; group++)
+		replay[group] = fullReset || group == SEQUENCE_START ||
+			!sequenceGroupEqual(seq, &core->live, group);
+
+	// the filter is held in reset while it or the calibration is reloaded
+	replay[SEQUENCE_MODE] |= replay[SEQUENCE_FILTER] |
+		replay[SEQUENCE_ZEROCAL] | replay[SEQUENCE_FULLCAL];
+
+	for (group = 0; group < SEQUENCE_GROUPS; group++) {
+		if (!replay[group])
+			continue;
+
+		for (w = &seq->writes[seq->groupStart[group]];
+			 w < &seq->writes[seq->groupStart[group + 1]]; w++) {
+			if (w == &seq->writes[seq->groupStart[SEQUENCE_START] + SEQUENCE_FIRE_WRITE])
+				break;
+			if (waitForAdcReady(core))
+				return -1;
+			ni4050_outb(core, w->value, w->reg); // flush
+			writes++;
+		}
+	}
+
+	// the fire write goes out without polling
+	if (waitForAdcReady(core))
+		return -1;
+
+	core->armed = seq;
+	core->switchStats.registerWrites = writes;
+	core->switchStats.fullReset = fullReset;
+	return 0;
+}
+
+// Release the filter of a prepared card, a single port write
+void startMeasurmentFire(struct ni4050_core *core)
+{
+	const RegisterWrite *w = &core->armed->writes[core->armed->groupStart[SEQUENCE_START] + SEQUENCE_FIRE_WRITE];
+
+	ni4050_outb(core, w->value, w->reg);
+	core->switchStats.registerWrites++;
+}
+
+// Set a fired card to read and turn its conversion interrupt back on
+int startMeasurmentFinish(struct ni4050_core *core)
+{
+	const ProgrammingSequence *seq = core->armed;
+	const RegisterWrite *w;
+
+	core->armed = NULL;
+	for (w = &seq->writes[seq->groupStart[SEQUENCE_START] + SEQUENCE_FIRE_WRITE + 1];
+		 w < &seq->writes[seq->groupStart[SEQUENCE_START + 1]]; w++) {
+		if (waitForAdcReady(core))
+			return -1;
+		ni4050_outb(core, w->value, w->reg);
+		core->switchStats.registerWrites++;
+	}
+
+	core->live = *seq;
+	core->liveValid = 1;
+
+	// Raise an interrupt on every new conversion
+	if (core->command)
+		ni4050_outb(core, core->command, NI4050_COMMAND_REG);
+
+	core->switchStats.portIO = core->ioCount;
+
+	pr_debug("// Measurement started, %d writes %d port I/O\n",
+		core->switchStats.registerWrites, core->ioCount);
+	return 0;
+}
+
+// Program the ADC for a measurement and start converting
+int startMeasurment(struct ni4050_core *core, NI4050_RANGES measurementMode)
+{
+	if (startMeasurmentPrepare(core, measurementMode))
+		return -1;
+
+	startMeasurmentFire(core);
+	return startMeasurmentFinish(core);
+}
@@ -0,0 +1,235 @@
+/*
+  * Hardware independent part of the NI4050 driver
+  *
+  * ni4050_core.h
+  *
+  * The range tables, the EEPROM calibration cache, the ADC programming and
+  * the conversion scales. All port I/O goes through struct ni4050_ops, so
+  * the same code runs in the kernel module and, on top of the register
+  * simulator, in userspace.
+  */
+
+#ifndef	_NI4050_CORE_H_
+#define	_NI4050_CORE_H_
+
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#else
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef pr_debug
+#ifdef NI4050_CORE_DEBUG
+#include <stdio.h>
+#define pr_debug(...)	fprintf(stderr, __VA_ARGS__)
+#else
+#define pr_debug(...)	do { } while (0)
+#endif
+#endif
+
+typedef uint64_t u64;
+#endif
+
+#include "ni4050.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+	unsigned int range;
+	unsigned int calConstantOffset;
+	unsigned char inputRange;
+	unsigned char ohmsMode;
+	unsigned char acRange;
+	unsigned char ohmsRange;
+	unsigned char measurmentMode;
+	unsigned char gain;
+	unsigned int filterValueH;
+	unsigned int filterValueL;
+	// integer conversion scale handed out by NIDMM_IOCGETSCALE
+	unsigned int scaleNum;
+	unsigned int scaleDen;
+	unsigned int scaleFlags;
+} MeasurementData;
+
+extern MeasurementData measurmentInfo[NI4050_RANGE_COUNT];
+
+#define NI4050_MEASUREMENT_COUNT	NI4050_RANGE_COUNT
+
+// Calibration coefficients of one measurmentInfo[] row and filter preset
+typedef struct
+{
+	int zeroScale;
+	int fullScale;
+} CalibrationData;
+
+// Filter words and EEPROM calibration set of the NI4050_FILTER_* presets
+typedef struct
+{
+	unsigned char filterValueH;
+	unsigned char filterValueL;
+	unsigned int calOffset;
+} FilterPreset;
+
+// the filter bits of measurmentInfo[].calConstantOffset
+#define NI4050_EEPROM_FILTER_MASK	0x0F
+
+// Filter chosen for one measurmentInfo[] row
+typedef struct
+{
+	unsigned char filterValueH;
+	unsigned char filterValueL;
+	unsigned int preset;	// calibration set, NI4050_FILTER_*
+} FilterSetting;
+
+// One register write of the ADC programming sequence
+typedef struct
+{
+	unsigned char reg;
+	unsigned char value;
+} RegisterWrite;
+
+// Groups of the programming sequence, replayed only when they differ
+// from what the card was last programmed with
+enum
+{
+	SEQUENCE_CONFIG,
+	SEQUENCE_MODE,
+	SEQUENCE_FILTER,
+	SEQUENCE_ZEROCAL,
+	SEQUENCE_FULLCAL,
+	SEQUENCE_START,
+	SEQUENCE_GROUPS
+};
+
+// Write of the SEQUENCE_START group which takes the filter out of reset,
+// the first conversion is timed from it
+#define SEQUENCE_FIRE_WRITE		1
+
+#define NI4050_SEQUENCE_MAX		18
+
+// Register writes of one measurmentInfo[] row, built once per calibration load
+typedef struct
+{
+	unsigned short family;	// ADC mode and ohms mode, a change needs a reset
+	unsigned char length;
+	unsigned char groupStart[SEQUENCE_GROUPS + 1];
+	RegisterWrite writes[NI4050_SEQUENCE_MAX];
+} ProgrammingSequence;
+
+// Port I/O of one card, reg is relative to the card I/O base
+struct ni4050_ops
+{
+	unsigned char (*inb)(void *priv, unsigned int reg);
+	void (*outb)(void *priv, unsigned char val, unsigned int reg);
+	// sleep while the ADC is busy
+	void (*delay)(void *priv, unsigned int ms);
+};
+
+struct ni4050_core
+{
+	const struct ni4050_ops *ops;
+	void *priv;
+
+	// NI4050_COMMAND_REG value while a measurement runs
+	unsigned char command;
+
+	// internal resistance of the card readed from the EEPROM
+	unsigned int dIntResistorValue;
+
+	// image of the whole EEPROM, the calibration is parsed from it
+	unsigned char eeprom[NI4050_EEPROM_SIZE];
+	int eepromValid;
+
+	// calibration constants cached from the EEPROM, indexed as measurmentInfo[]
+	CalibrationData cal[NI4050_MEASUREMENT_COUNT][NI4050_FILTER_PRESETS];
+	int calibrationValid;
+
+	// filter of every measurement, the defaults come from measurmentInfo[]
+	FilterSetting filter[NI4050_MEASUREMENT_COUNT];
+
+	// precompiled programming sequences and the one the ADC holds now
+	ProgrammingSequence sequence[NI4050_MEASUREMENT_COUNT];
+	ProgrammingSequence live;
+	int liveValid;
+	// sequence between startMeasurmentPrepare() and startMeasurmentFinish()
+	const ProgrammingSequence *armed;
+
+	// port I/O accounting of the last range switch
+	unsigned int ioCount;
+	NI4050SwitchStats switchStats;
+
+	// waitForAdcReady() calls which gave up
+	unsigned int adcTimeouts;
+
+	// the current measurement type
+	NI4050_RANGES measurmentMode;
+
+	int ZeroScaleCalCoeff;
+	int FullScaleCalCoeff;
+};
+
+// Register access of the acquisition path
+static inline unsigned char ni4050_coreInb(struct ni4050_core *core, unsigned int reg)
+{
+	return core->ops->inb(core->priv, reg);
+}
+
+static inline void ni4050_coreOutb(struct ni4050_core *core, unsigned char val, unsigned int reg)
+{
+	core->ops->outb(core->priv, val, reg);
+}
+
+static inline void ni4050_coreDelay(struct ni4050_core *core, unsigned int ms)
+{
+	core->ops->delay(core->priv, ms);
+}
+
+// Counted register access of the programming path
+static inline void ni4050_outb(struct ni4050_core *core, unsigned char val, unsigned int reg)
+{
+	core->ioCount++;
+	ni4050_coreOutb(core, val, reg);
+}
+
+static inline unsigned char ni4050_inb(struct ni4050_core *core, unsigned int reg)
+{
+	core->ioCount++;
+	return ni4050_coreInb(core, reg);
+}
+
+// Ranges of the autorange functions, from the highest to the lowest
+extern const NI4050_RANGES autorangeLadder[NI4050_AUTORANGE_FUNCTIONS][6];
+
+unsigned char readEEPROM(struct ni4050_core *core, unsigned int address);
+int readEEPROMWord(struct ni4050_core *core, unsigned int address);
+void setWriteEEPROMEnable(struct ni4050_core *core, unsigned char enabled);
+int adcReady(struct ni4050_core *core);
+int waitForAdcReady(struct ni4050_core *core);
+int eepromReadResistance(struct ni4050_core *core);
+void loadEeprom(struct ni4050_core *core);
+int loadCalibration(struct ni4050_core *core);
+int findMeasurement(NI4050_RANGES range);
+void initCommand(struct ni4050_core *core, int irq);
+void initFilters(struct ni4050_core *core);
+int setFilter(struct ni4050_core *core, NI4050Filter *filter);
+int measurmentIsReady(struct ni4050_core *core);
+int measurmentDataRegsRead(struct ni4050_core *core);
+int getConvertScale(struct ni4050_core *core, NI4050Scale *scale);
+NI4050_RANGES autorangeNext(const NI4050Autorange *autorange, const NI4050Sample *sample);
+int startMeasurmentPrepare(struct ni4050_core *core, NI4050_RANGES measurementMode);
+void startMeasurmentFire(struct ni4050_core *core);
+int startMeasurmentFinish(struct ni4050_core *core);
+int startMeasurment(struct ni4050_core *core, NI4050_RANGES measurementMode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _NI4050_CORE_H_ */
@@ -0,0 +1,1774 @@
+/*
+  * A driver for the National Instruments PCMCIA 4050 Digital Multimeter
+  *
+  * ni4050_cs.c
+  *
+  * Written by Miklós Márton martonmiklosqdev@gmail.com according to the
+  * provided MHDDK Windows CE example provided by the NI here:
+  * https://lumen.ni.com/nicif/us/evalmhddk/content.xhtml
+  * All rights reserved. Licensed under LGPL license.
+  */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/delay.h>
+#include <linux/bitrev.h>
+#include <linux/mutex.h>
+#include <linux/uaccess.h>
+#include <linux/io.h>
+#include <linux/wait.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/poll.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/device.h>
+#include <linux/sysfs.h>
+
+#include <pcmcia/cistpl.h>
+#include <pcmcia/cisreg.h>
+#include <pcmcia/ciscode.h>
+#include <pcmcia/ds.h>
+
+#include "ni4050_core.h"
+
+#define CREATE_TRACE_POINTS
+#include "ni4050_trace.h"
+
+// minor number -> struct ni4050_dev, read under RCU by open(), changed
+// under ni4050_mutex by probe and detach
+static DEFINE_IDR(ni4050_idr);
+static DEFINE_MUTEX(ni4050_mutex);
+
+// minors register_chrdev() reserves for us
+#define	NI4050_MINORS		256
+
+static void ni4050_release(struct pcmcia_device *link);
+
+static int major;		/* major number we get from the kernel */
+
+// ni4050/ in debugfs, one directory per card below
+static struct dentry *ni4050_debugfs;
+
+// log2 buckets of the time a reader waited for a conversion, in us
+#define	NI4050_WAIT_BUCKETS	20
+
+// Counters shown in debugfs, protected by the lock of the card
+struct ni4050_stats {
+	u64 samples;			// conversions read from the card
+	u64 overflows;			// ... with NI4050_STATUS_OVERFLOW set
+	u64 switches;			// startMeasurment() calls
+	u64 switchNsLast;
+	u64 switchNsMax;
+	u64 groupStarts;		// NIDMM_IOCGROUPSTART calls this card was part of
+	u64 groupSkewNsLast;	// filter release after the first card of the group
+	u64 groupSkewNsMax;
+	u32 waitHistogram[NI4050_WAIT_BUCKETS];
+};
+
+struct ni4050_dev {
+	// only valid while removed is not set, check it under mutex
+	struct pcmcia_device *p_dev;
+
+	// held by probe until detach and by every open file, the memory
+	// outlives the last reference by an RCU grace period for open()
+	struct kref kref;
+	struct rcu_head rcu;
+
+	// minor number, also names the debugfs directory and the trace events
+	int devno;
+
+	// serializes the hardware access of this card
+	struct mutex mutex;
+
+	// calibration cache and ADC programming state, port I/O goes
+	// through ni4050_pcmciaOps
+	struct ni4050_core core;
+
+	// clock of the sample timestamps
+	int clockId;
+
+	// interrupt line assigned by the PCMCIA layer, 0 if we have to poll
+	unsigned int irq;
+
+	// last conversion latched by the interrupt handler, protected by lock
+	spinlock_t lock;
+	wait_queue_head_t readq;
+	int newData;
+	NI4050Sample last;
+
+	// every conversion read from the card, shared by the readers of all
+	// open files which keep their own cursor; protected by lock
+	NI4050Sample stream[NI4050_FIFO_SAMPLES];
+	u64 streamHead;			// conversions published since probe
+
+	// the records of a controller reading with NI4050_OVERRUN_DROP_NEWEST,
+	// kept apart so it never holds back the stream; protected by lock
+	NI4050Sample held[NI4050_FIFO_SAMPLES];
+	u64 heldHead;
+
+	// continuous acquisition, also protected by lock
+	int continuous;
+	unsigned int overrunPolicy;
+	struct delayed_work pollWork;	// drains the card or serves poll() when there is no irq
+	// a mutex holder polls or reprograms the card itself, nothing may
+	// queue pollWork meanwhile; protected by lock
+	int hwBusy;
+
+	// the card was pulled, sleepers give up with -ENODEV and poll() reports POLLERR
+	int removed;
+
+	// the open file which may change the card state, NULL if none;
+	// changed under mutex and lock
+	struct ni4050_file *controller;
+
+	// autoranging, the state is protected by lock
+	NI4050Autorange autorange;
+	unsigned int settling;		// conversions still to discard
+	int rangePending;			// a switch to rangeTarget is due
+	NI4050_RANGES rangeTarget;
+	struct work_struct rangeWork;	// switches when no reader holds the mutex
+
+	// sample ring shared with userspace through mmap(), set under lock.
+	// Userspace may write the whole header page, the indices the driver
+	// relies on are kept here and only copied there for the reader.
+	NI4050RingHeader *ring;
+	NI4050Sample *ringRecords;
+	unsigned long ringSize;
+	u64 ringHead;
+	u32 ringCapacity;
+
+	struct ni4050_stats stats;
+	struct dentry *debugfs;
+
+	// nidmmN in the ni_4050 class, carries the eeprom attribute
+	struct device *device;
+
+	unsigned char flags0;	/* cardman IO-flags 0 */
+	unsigned char flags1;	/* cardman IO-flags 1 */
+
+	unsigned char ta1;
+	unsigned char proto;	/* T=0, T=1, ... */
+	unsigned long flags;	/* lock+flags (MONITOR,IO,ATR) * for concurrent
+				   access */
+
+
+};
+
+
+// An open file. The first one opened for writing controls the card, the
+// read-only ones subscribe to the conversions it produces.
+struct ni4050_file {
+	struct ni4050_dev *dev;
+	int controller;
+
+	// next record of dev->stream, or dev->held, to hand out and the
+	// records lost on the way, protected by dev->lock
+	u64 cursor;
+	u64 overruns;
+};
+
+static struct class *ni4050_class;
+
+static const struct file_operations ni4050_fops;
+
+static unsigned char ni4050_pcmciaInb(void *priv, unsigned int reg)
+{
+	struct ni4050_dev *dev = priv;
+	unsigned char val = inb(dev->p_dev->resource[0]->start + reg);
+
+	trace_ni4050_reg_read(dev->devno, reg, val);
+	return val;
+}
+
+static void ni4050_pcmciaOutb(void *priv, unsigned char val, unsigned int reg)
+{
+	struct ni4050_dev *dev = priv;
+
+	trace_ni4050_reg_write(dev->devno, reg, val);
+	outb(val, dev->p_dev->resource[0]->start + reg);
+}
+
+static void ni4050_pcmciaDelay(void *priv, unsigned int ms)
+{
+	msleep(ms);
+}
+
+static const struct ni4050_ops ni4050_pcmciaOps = {
+	.inb	= ni4050_pcmciaInb,
+	.outb	= ni4050_pcmciaOutb,
+	.delay	= ni4050_pcmciaDelay,
+};
+
+// The controller reads dev->held instead of the stream
+static int streamHeld(struct ni4050_dev *dev, struct ni4050_file *file)
+{
+	return file->controller && dev->continuous &&
+		dev->overrunPolicy == NI4050_OVERRUN_DROP_NEWEST;
+}
+
+// Publish a conversion to the readers of every open file, called with
+// dev->lock held. Nobody waits for a slow reader, it loses the oldest
+// records. A controller reading with NI4050_OVERRUN_DROP_NEWEST loses the
+// newest ones from its own copy instead.
+static void streamPublish(struct ni4050_dev *dev, const NI4050Sample *sample)
+{
+	struct ni4050_file *controller = dev->controller;
+
+	dev->stream[dev->streamHead & (NI4050_FIFO_SAMPLES - 1)] = *sample;
+	dev->streamHead++;
+
+	if (controller && streamHeld(dev, controller)) {
+		if (dev->heldHead - controller->cursor >= NI4050_FIFO_SAMPLES) {
+			controller->overruns++;
+			return;
+		}
+		dev->held[dev->heldHead & (NI4050_FIFO_SAMPLES - 1)] = *sample;
+		dev->heldHead++;
+	}
+}
+
+static int streamEmpty(struct ni4050_dev *dev, struct ni4050_file *file)
+{
+	if (streamHeld(dev, file))
+		return ACCESS_ONCE(dev->heldHead) == ACCESS_ONCE(file->cursor);
+	return ACCESS_ONCE(dev->streamHead) == ACCESS_ONCE(file->cursor);
+}
+
+// Take up to count records after the cursor of file, the ones the stream
+// overwrote meanwhile are counted as overruns. Called with dev->lock held.
+static unsigned int streamRead(struct ni4050_dev *dev, struct ni4050_file *file,
+		NI4050Sample *samples, unsigned int count)
+{
+	u64 pending;
+	unsigned int i;
+
+	if (streamHeld(dev, file)) {
+		pending = dev->heldHead - file->cursor;
+		if (count > pending)
+			count = pending;
+		for (i = 0; i < count; i++)
+			samples[i] = dev->held[(file->cursor + i) & (NI4050_FIFO_SAMPLES - 1)];
+		file->cursor += count;
+		return count;
+	}
+
+	pending = dev->streamHead - file->cursor;
+	if (pending > NI4050_FIFO_SAMPLES) {
+		file->overruns += pending - NI4050_FIFO_SAMPLES;
+		file->cursor = dev->streamHead - NI4050_FIFO_SAMPLES;
+		pending = NI4050_FIFO_SAMPLES;
+	}
+
+	if (count > pending)
+		count = pending;
+	for (i = 0; i < count; i++)
+		samples[i] = dev->stream[(file->cursor + i) & (NI4050_FIFO_SAMPLES - 1)];
+	file->cursor += count;
+
+	return count;
+}
+
+// Publish a conversion into the mapped ring, called with dev->lock held
+static void ringPublish(struct ni4050_dev *dev, NI4050Sample *sample)
+{
+	NI4050RingHeader *ring = dev->ring;
+	u64 head = dev->ringHead;
+
+	if (head - ACCESS_ONCE(ring->tail) >= dev->ringCapacity) {
+		ring->overruns++;
+		if (dev->overrunPolicy == NI4050_OVERRUN_DROP_NEWEST)
+			return;
+		// the reader notices from head that it has been lapped
+	}
+
+	dev->ringRecords[head & (dev->ringCapacity - 1)] = *sample;
+	dev->ringHead = head + 1;
+	smp_wmb();	// the record is visible before the new head
+	ring->head = dev->ringHead;
+}
+
+// Timestamp of a conversion on the clock chosen with NIDMM_IOCSETCLOCK
+static ktime_t sampleTime(struct ni4050_dev *dev)
+{
+	switch (dev->clockId) {
+	case CLOCK_BOOTTIME:
+		return ktime_get_boottime();
+	case CLOCK_TAI:
+		return ktime_get_clocktai();
+	default:
+		return ktime_get();
+	}
+}
+
+static void fillSample(struct ni4050_dev *dev, NI4050Sample *sample,
+		int value, unsigned char status)
+{
+	sample->timestamp = ktime_to_ns(sampleTime(dev));
+	sample->value = value & 0xffffff;
+	sample->status = status;
+	sample->range = dev->core.measurmentMode;
+	sample->reserved = 0;
+
+	trace_ni4050_sample(dev->devno, sample);
+}
+
+// Count a conversion read from the card, called with dev->lock held
+static void sampleStats(struct ni4050_dev *dev, const NI4050Sample *sample)
+{
+	dev->stats.samples++;
+	if (sample->status & NI4050_STATUS_OVERFLOW)
+		dev->stats.overflows++;
+}
+
+// Account the time a reader waited since start, called with dev->lock held
+static void waitStats(struct ni4050_dev *dev, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	unsigned int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= NI4050_WAIT_BUCKETS)
+		bucket = NI4050_WAIT_BUCKETS - 1;
+	dev->stats.waitHistogram[bucket]++;
+}
+
+static int autorangeAccept(struct ni4050_dev *dev, const NI4050Sample *sample);
+
+// Publish a finished conversion and wake up the readers
+static void sampleReady(struct ni4050_dev *dev, int value, unsigned char status)
+{
+	unsigned long flags;
+	NI4050Sample sample;
+
+	fillSample(dev, &sample, value, status);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	sampleStats(dev, &sample);
+	if (!autorangeAccept(dev, &sample)) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		// a reader holding the mutex switches itself, else the work does
+		if (dev->rangePending) {
+			wake_up_interruptible(&dev->readq);
+			schedule_work(&dev->rangeWork);
+		}
+		return;
+	}
+	dev->last = sample;
+	dev->newData = 1;
+	streamPublish(dev, &sample);
+	if (dev->continuous && dev->ring)
+		ringPublish(dev, &sample);
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	wake_up_interruptible(&dev->readq);
+}
+
+// Conversion complete interrupt: latch the result and wake up the readers
+static irqreturn_t ni4050_interrupt(int irq, void *dev_id)
+{
+	struct ni4050_dev *dev = dev_id;
+	unsigned char status;
+
+	status = ni4050_coreInb(&dev->core, NI4050_STATUS_REG);
+	if (!(status & NI4050_STATUS_NEW_DATA))
+		return IRQ_NONE; // shared line, not ours
+
+	sampleReady(dev, measurmentDataRegsRead(&dev->core), status);
+	return IRQ_HANDLED;
+}
+
+// No irq: poll the card once per jiffy, for good in continuous mode,
+// otherwise until the next conversion is latched and nobody waits
+static void ni4050_pollWork(struct work_struct *work)
+{
+	struct ni4050_dev *dev = container_of(to_delayed_work(work), struct ni4050_dev, pollWork);
+	unsigned char status;
+
+	status = ni4050_coreInb(&dev->core, NI4050_STATUS_REG);
+	if (status & NI4050_STATUS_NEW_DATA)
+		sampleReady(dev, measurmentDataRegsRead(&dev->core), status);
+
+	spin_lock_irq(&dev->lock);
+	if (!dev->hwBusy && (dev->continuous || (dev->core.liveValid && !dev->removed &&
+			(!dev->newData || waitqueue_active(&dev->readq)))))
+		schedule_delayed_work(&dev->pollWork, 1);
+	spin_unlock_irq(&dev->lock);
+}
+
+// Without an irq nothing reads the card for a subscriber unless it asks.
+// Checked under lock, detach sets removed under it before the last cancel.
+static void streamKick(struct ni4050_dev *dev)
+{
+	spin_lock_irq(&dev->lock);
+	if (!dev->irq && !dev->continuous && dev->core.liveValid && !dev->removed && !dev->hwBusy)
+		schedule_delayed_work(&dev->pollWork, 1);
+	spin_unlock_irq(&dev->lock);
+}
+
+// Take the card registers from the poll work for a path holding dev->mutex
+static void hwClaim(struct ni4050_dev *dev)
+{
+	if (dev->irq)
+		return;
+
+	spin_lock_irq(&dev->lock);
+	dev->hwBusy = 1;
+	spin_unlock_irq(&dev->lock);
+	cancel_delayed_work_sync(&dev->pollWork);
+}
+
+// Hand them back, the poll work resumes if somebody depends on it
+static void hwRelease(struct ni4050_dev *dev)
+{
+	if (dev->irq)
+		return;
+
+	spin_lock_irq(&dev->lock);
+	dev->hwBusy = 0;
+	if (!dev->removed && (dev->continuous ||
+			(dev->core.liveValid && waitqueue_active(&dev->readq))))
+		schedule_delayed_work(&dev->pollWork, 1);
+	spin_unlock_irq(&dev->lock);
+}
+
+// Take the conversion latched by the interrupt handler or poll work,
+// waiting for it if wait is set. Returns 1 when woken for a pending
+// autorange switch instead.
+static int measurmentSampleReadLatched(struct ni4050_dev *dev, NI4050Sample *sample, int wait)
+{
+	long ret;
+
+	if (!wait && !dev->newData)
+		return -EAGAIN;
+
+	ret = wait_event_interruptible_timeout(dev->readq,
+			dev->newData || dev->rangePending || dev->removed,
+			msecs_to_jiffies(NI4050_MEASURE_READY_TIMEOUT_MS));
+	if (ret < 0)
+		return ret;
+	if (ret == 0)
+		return -ETIMEDOUT;
+	if (dev->removed)
+		return -ENODEV;
+
+	spin_lock_irq(&dev->lock);
+	if (!dev->newData) {
+		spin_unlock_irq(&dev->lock);
+		return 1;
+	}
+	*sample = dev->last;
+	dev->newData = 0;
+	spin_unlock_irq(&dev->lock);
+
+	if (sample->status & NI4050_STATUS_OVERFLOW)
+	{
+		pr_debug("Overflow\n");
+	}
+	pr_debug ("Measurement raw value: %06x\n", sample->value);
+	return 0;
+}
+
+static int autorangeSwitch(struct ni4050_dev *dev);
+
+// No interrupt line assigned, poll the status register. Called between
+// hwClaim() and hwRelease(), returns as measurmentSampleReadOnce().
+static int measurmentSamplePoll(struct ni4050_dev *dev, NI4050Sample *sample, int wait,
+		ktime_t start)
+{
+	unsigned int i = 0;
+	unsigned char status;
+	int accept;
+
+	while ((status = measurmentIsReady(&dev->core)) == 0)
+	{
+		if (!wait)
+			return -EAGAIN;
+		if (dev->removed)
+			return -ENODEV;
+		msleep(1);
+		i++;
+		if (i == NI4050_MEASURE_READY_TIMEOUT_MS) 
+			return -ETIMEDOUT;
+	}
+
+	fillSample(dev, sample, measurmentDataRegsRead(&dev->core), status);
+	pr_debug ("Measurement raw value: %06x after %d ms\n", sample->value, i);
+
+	spin_lock_irq(&dev->lock);
+	sampleStats(dev, sample);
+	waitStats(dev, start);
+	accept = autorangeAccept(dev, sample);
+	if (accept)
+		streamPublish(dev, sample);
+	spin_unlock_irq(&dev->lock);
+
+	if (accept)
+		wake_up_interruptible(&dev->readq);
+	return !accept;
+}
+
+// Read the next conversion together with its status and timestamp. Returns
+// 1 if the conversion was discarded by the autorange.
+static int measurmentSampleReadOnce(struct ni4050_dev *dev, NI4050Sample *sample, int wait)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	// keep the poll work off the data registers, it may have latched one
+	if (!dev->irq && !dev->continuous) {
+		hwClaim(dev);
+		if (!dev->newData) {
+			ret = measurmentSamplePoll(dev, sample, wait, start);
+			hwRelease(dev);
+			return ret;
+		}
+		hwRelease(dev);
+	}
+
+	ret = measurmentSampleReadLatched(dev, sample, wait);
+	if (ret == 0) {
+		spin_lock_irq(&dev->lock);
+		waitStats(dev, start);
+		spin_unlock_irq(&dev->lock);
+	}
+	return ret;
+}
+
+// Read the next valid conversion, switching ranges on the way if the
+// autorange asks for it
+static int measurmentSampleRead(struct ni4050_dev *dev, NI4050Sample *sample, int wait)
+{
+	int ret;
+
+	do {
+		ret = autorangeSwitch(dev);
+		if (ret)
+			return ret;
+		ret = measurmentSampleReadOnce(dev, sample, wait);
+	} while (ret == 1);
+
+	return ret;
+}
+
+// Read 3-byte data value (binary measurement) from the board, -EAGAIN
+// if wait is not set and no new conversion is ready
+int measurmentDataRead(struct ni4050_dev *dev, int *value, int wait)
+{
+	NI4050Sample sample;
+	int ret;
+
+	*value = 0x7fffff;
+	ret = measurmentSampleRead(dev, &sample, wait);
+	if (ret)
+		return ret;
+
+	*value = sample.value;
+	return 0;
+};
+
+// Take up to count records of the stream, for the controller in continuous
+// mode and for a subscriber. Returns 0 if the controller was woken for a
+// pending autorange switch.
+static int streamSamplesRead(struct ni4050_file *file, NI4050Sample *samples,
+		unsigned int count, int wait)
+{
+	struct ni4050_dev *dev = file->dev;
+	ktime_t start = ktime_get();
+	long ret;
+
+	if (wait) {
+		if (!file->controller)
+			streamKick(dev);
+		ret = wait_event_interruptible_timeout(dev->readq,
+				!streamEmpty(dev, file) || dev->removed ||
+				(file->controller && (!dev->continuous || dev->rangePending)),
+				msecs_to_jiffies(NI4050_MEASURE_READY_TIMEOUT_MS));
+		if (ret < 0)
+			return ret;
+		if (ret == 0)
+			return -ETIMEDOUT;
+		if (dev->removed)
+			return -ENODEV;
+	}
+
+	spin_lock_irq(&dev->lock);
+	count = streamRead(dev, file, samples, count);
+	if (count && wait && file->controller)
+		waitStats(dev, start);
+	spin_unlock_irq(&dev->lock);
+
+	if (count)
+		return count;
+	return file->controller && dev->rangePending ? 0 : -EAGAIN;
+}
+
+// Fill the user array of a NIDMM_IOCREADSAMPLES call. Blocks for the first
+// record only, or for all of them with NI4050_READ_WAITALL, and not at all
+// if nonblock is set. Only the controller holds dev->mutex.
+static int readSamples(struct ni4050_file *file, NI4050SampleBatch *batch, int nonblock)
+{
+	struct ni4050_dev *dev = file->dev;
+	NI4050Sample __user *out = (NI4050Sample __user *)(unsigned long)batch->samples;
+	NI4050Sample samples[16];
+	unsigned int done = 0;
+	int wait, ret = 0;
+
+	while (done < batch->count) {
+		wait = !nonblock && ((done == 0) || (batch->flags & NI4050_READ_WAITALL));
+
+		if (!file->controller || dev->continuous) {
+			ret = file->controller ? autorangeSwitch(dev) : 0;
+			if (ret)
+				break;
+			ret = streamSamplesRead(file, samples,
+					min_t(unsigned int, ARRAY_SIZE(samples), batch->count - done), wait);
+		} else
+			ret = measurmentSampleRead(dev, samples, wait) ? : 1;
+
+		if (ret < 0)
+			break;
+		if (ret == 0)
+			continue;
+
+		if (copy_to_user(out + done, samples, ret * sizeof(NI4050Sample))) {
+			ret = -EFAULT;
+			break;
+		}
+		done += ret;
+		ret = 0;
+	}
+
+	batch->count = done;
+	if (done && ret != -EFAULT)
+		return 0;
+	return ret;
+}
+
+
+// Start handing every conversion to the controller
+static void startContinuous(struct ni4050_file *file, unsigned int overrunPolicy)
+{
+	struct ni4050_dev *dev = file->dev;
+
+	spin_lock_irq(&dev->lock);
+	file->overruns = 0;
+	dev->overrunPolicy = overrunPolicy;
+	dev->continuous = 1;
+	file->cursor = streamHeld(dev, file) ? dev->heldHead : dev->streamHead;
+	spin_unlock_irq(&dev->lock);
+
+	if (!dev->irq)
+		schedule_delayed_work(&dev->pollWork, 1);
+}
+
+static void stopContinuous(struct ni4050_dev *dev)
+{
+	spin_lock_irq(&dev->lock);
+	dev->continuous = 0;
+	// the cursor may have pointed into dev->held
+	if (dev->controller)
+		dev->controller->cursor = dev->streamHead;
+	spin_unlock_irq(&dev->lock);
+
+	cancel_delayed_work_sync(&dev->pollWork);
+	wake_up_interruptible(&dev->readq);
+}
+
+// Keep the poll work off the registers while the card is reprogrammed,
+// a kick meanwhile would still find the old sequence live
+static void switchRangeBegin(struct ni4050_dev *dev)
+{
+	hwClaim(dev);
+}
+
+// Account a reprogramming which began at start and resume the poll work
+static void switchRangeEnd(struct ni4050_dev *dev, NI4050_RANGES from, NI4050_RANGES range,
+		int rc, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	hwRelease(dev);
+
+	trace_ni4050_range_switch(dev->devno, from, range, rc, ns, &dev->core.switchStats);
+	spin_lock_irq(&dev->lock);
+	dev->stats.switches++;
+	dev->stats.switchNsLast = ns;
+	if (ns > dev->stats.switchNsMax)
+		dev->stats.switchNsMax = ns;
+	spin_unlock_irq(&dev->lock);
+
+	// nothing latched before the switch is handed out
+	if (!rc) {
+		spin_lock_irq(&dev->lock);
+		dev->newData = 0;
+		spin_unlock_irq(&dev->lock);
+	}
+}
+
+// Reprogram the card with the poll work kept off the registers
+static int switchRange(struct ni4050_dev *dev, NI4050_RANGES range)
+{
+	NI4050_RANGES from = dev->core.measurmentMode;
+	ktime_t start;
+	int rc;
+
+	switchRangeBegin(dev);
+	start = ktime_get();
+	rc = startMeasurment(&dev->core, range);
+	switchRangeEnd(dev, from, range, rc, start);
+
+	return rc;
+}
+
+// Autorange bookkeeping of a new conversion, called with dev->lock held.
+// Returns 0 if the conversion has to be discarded.
+static int autorangeAccept(struct ni4050_dev *dev, const NI4050Sample *sample)
+{
+	NI4050_RANGES next;
+
+	if (dev->autorange.function == NI4050_AUTORANGE_OFF)
+		return 1;
+	if (dev->rangePending)
+		return 0;
+	if (dev->settling) {
+		dev->settling--;
+		return 0;
+	}
+
+	next = autorangeNext(&dev->autorange, sample);
+	if (next == sample->range)
+		return 1;
+
+	pr_debug("Autorange %d -> %d\n", sample->range, next);
+	dev->rangeTarget = next;
+	dev->rangePending = 1;
+	return 0;
+}
+
+// Carry out a switch requested by autorangeAccept(), called with dev->mutex held
+static int autorangeSwitch(struct ni4050_dev *dev)
+{
+	NI4050_RANGES target;
+	int rc;
+
+	spin_lock_irq(&dev->lock);
+	target = dev->rangeTarget;
+	rc = dev->rangePending;
+	spin_unlock_irq(&dev->lock);
+	if (!rc)
+		return 0;
+
+	rc = switchRange(dev, target);
+
+	spin_lock_irq(&dev->lock);
+	dev->settling = dev->autorange.settleSamples;
+	dev->rangePending = 0;
+	if (rc)
+		dev->autorange.function = NI4050_AUTORANGE_OFF;
+	spin_unlock_irq(&dev->lock);
+
+	return rc;
+}
+
+static void ni4050_rangeWork(struct work_struct *work)
+{
+	struct ni4050_dev *dev = container_of(work, struct ni4050_dev, rangeWork);
+
+	mutex_lock(&dev->mutex);
+	if (!dev->removed && pcmcia_dev_present(dev->p_dev))
+		autorangeSwitch(dev);
+	mutex_unlock(&dev->mutex);
+}
+
+static void stopAutorange(struct ni4050_dev *dev)
+{
+	spin_lock_irq(&dev->lock);
+	dev->autorange.function = NI4050_AUTORANGE_OFF;
+	dev->rangePending = 0;
+	spin_unlock_irq(&dev->lock);
+}
+
+// Autorange a function, starting from the current range if it belongs to it
+static int setAutorange(struct ni4050_dev *dev, NI4050Autorange *autorange)
+{
+	const NI4050_RANGES *ladder;
+	int i, start = 0;
+
+	if (autorange->function >= NI4050_AUTORANGE_FUNCTIONS)
+		return -EINVAL;
+	if (!autorange->upPermille)
+		autorange->upPermille = NI4050_AUTORANGE_UP_DEFAULT;
+	if (!autorange->downPermille)
+		autorange->downPermille = NI4050_AUTORANGE_DOWN_DEFAULT;
+	if (!autorange->settleSamples)
+		autorange->settleSamples = NI4050_AUTORANGE_SETTLE_DEFAULT;
+	if (autorange->upPermille > 1000 || autorange->downPermille >= autorange->upPermille)
+		return -EINVAL;
+
+	stopAutorange(dev);
+	if (autorange->function == NI4050_AUTORANGE_OFF)
+		return 0;
+
+	ladder = autorangeLadder[autorange->function];
+	for (i = 0; ladder[i] != NI4050_RANGE_INVALID; i++)
+		if (dev->core.liveValid && ladder[i] == dev->core.measurmentMode)
+			start = i;
+
+	spin_lock_irq(&dev->lock);
+	dev->autorange = *autorange;
+	dev->rangeTarget = ladder[start];
+	dev->rangePending = 1;
+	spin_unlock_irq(&dev->lock);
+
+	return autorangeSwitch(dev);
+}
+
+// Start the cards of a NIDMM_IOCGROUPSTART together. The card mutexes are
+// taken in minor order, so overlapping groups do not deadlock.
+static int groupStart(void __user *argp)
+{
+	NI4050GroupStart group;
+	struct fd files[NI4050_GROUP_MAX];
+	struct ni4050_dev *devs[NI4050_GROUP_MAX];
+	struct ni4050_file *file;
+	NI4050_RANGES from[NI4050_GROUP_MAX];
+	unsigned int order[NI4050_GROUP_MAX];
+	unsigned int i, n;
+	unsigned long flags;
+	ktime_t start;
+	u64 skew;
+	int rc = 0;
+
+	if (copy_from_user(&group, argp, sizeof(group)))
+		return -EFAULT;
+	if (group.count == 0 || group.count > NI4050_GROUP_MAX)
+		return -EINVAL;
+
+	for (n = 0; n < group.count; n++) {
+		files[n] = fdget(group.fd[n]);
+		if (!files[n].file) {
+			rc = -EBADF;
+			goto put;
+		}
+		if (files[n].file->f_op != &ni4050_fops) {
+			fdput(files[n]);
+			rc = -EINVAL;
+			goto put;
+		}
+		// only the controllers of the cards may start them
+		file = files[n].file->private_data;
+		if (!file->controller) {
+			fdput(files[n]);
+			rc = -EPERM;
+			goto put;
+		}
+		devs[n] = file->dev;
+
+		// insert by minor, a card named twice is an error
+		for (i = n; i > 0 && devs[order[i - 1]]->devno >= devs[n]->devno; i--)
+			order[i] = order[i - 1];
+		order[i] = n;
+		if (i < n && devs[order[i + 1]]->devno == devs[n]->devno) {
+			fdput(files[n]);
+			rc = -EINVAL;
+			goto put;
+		}
+	}
+
+	for (i = 0; i < group.count; i++)
+		mutex_lock_nested(&devs[order[i]]->mutex, i);
+
+	for (i = 0; i < group.count; i++) {
+		if (devs[i]->removed || !pcmcia_dev_present(devs[i]->p_dev)) {
+			rc = -ENODEV;
+			goto unlock;
+		}
+		if (devs[i]->clockId != devs[0]->clockId || findMeasurement(group.range[i]) < 0) {
+			rc = -EINVAL;
+			goto unlock;
+		}
+	}
+
+	for (i = 0; i < group.count; i++) {
+		stopAutorange(devs[i]);
+		switchRangeBegin(devs[i]);
+		from[i] = devs[i]->core.measurmentMode;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < group.count && !rc; i++)
+		if (startMeasurmentPrepare(&devs[i]->core, group.range[i]))
+			rc = -EIO;
+
+	if (!rc) {
+		// the only part of the start the skew depends on
+		local_irq_save(flags);
+		for (i = 0; i < group.count; i++) {
+			startMeasurmentFire(&devs[i]->core);
+			group.started[i] = ktime_to_ns(sampleTime(devs[i]));
+		}
+		local_irq_restore(flags);
+
+		for (i = 0; i < group.count; i++)
+			if (startMeasurmentFinish(&devs[i]->core))
+				rc = -EIO;
+	}
+
+	for (i = 0; i < group.count; i++) {
+		switchRangeEnd(devs[i], from[i], group.range[i], rc, start);
+		if (rc)
+			continue;
+
+		skew = group.started[i] - group.started[0];
+		spin_lock_irq(&devs[i]->lock);
+		devs[i]->stats.groupStarts++;
+		devs[i]->stats.groupSkewNsLast = skew;
+		if (skew > devs[i]->stats.groupSkewNsMax)
+			devs[i]->stats.groupSkewNsMax = skew;
+		spin_unlock_irq(&devs[i]->lock);
+	}
+
+	if (!rc && copy_to_user(argp, &group, sizeof(group)))
+		rc = -EFAULT;
+
+unlock:
+	for (i = group.count; i > 0; i--)
+		mutex_unlock(&devs[order[i - 1]]->mutex);
+put:
+	for (i = 0; i < n; i++)
+		fdput(files[i]);
+	return rc;
+}
+
+// Calls a subscriber serves from the stream, without dev->mutex. The ones
+// which change the card belong to the controller, -ENOIOCTLCMD leaves the
+// read-only rest to ni4050_ioctl().
+static long subscriberIoctl(struct ni4050_file *file, unsigned int cmd, void __user *argp,
+		int nonblock)
+{
+	NI4050SampleBatch batch;
+	NI4050Sample sample;
+	int rc;
+
+	if (file->dev->removed)
+		return -ENODEV;
+
+	switch (cmd) {
+	case NIDMM_IOCREADRAW:
+		rc = streamSamplesRead(file, &sample, 1, !nonblock);
+		if (rc < 0)
+			return rc;
+		return put_user(sample.value, (unsigned int __user *)argp);
+	case NIDMM_IOCREADSAMPLES:
+		if (copy_from_user(&batch, argp, sizeof(batch)))
+			return -EFAULT;
+		rc = readSamples(file, &batch, nonblock);
+		if (!rc && copy_to_user(argp, &batch, sizeof(batch)))
+			rc = -EFAULT;
+		return rc;
+	case NIDMM_IOCEEPROMREAD:
+	case NIDMM_IOCEEPROMREADBLOCK:
+	case NIDMM_IOCEEPROMREADINTRES:
+	case NIDMM_IOCGETOVERRUNS:
+	case NIDMM_IOCGETSCALE:
+	case NIDMM_IOCGETSWITCHSTATS:
+	// checks the descriptors of its argument instead
+	case NIDMM_IOCGROUPSTART:
+		return -ENOIOCTLCMD;
+	default:
+		return -EPERM;
+	}
+}
+
+static long ni4050_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct ni4050_file *file = filp->private_data;
+	struct ni4050_dev *dev = file->dev;
+	int size;
+	int rc;
+	void __user *argp = (void __user *)arg;
+	unsigned int *dIntResistorValue;
+	EEPROMInfo eepromInfo;
+	NI4050_RANGES *range;
+	NI4050ContinuousMode continuousMode;
+	NI4050Scale scale;
+	NI4050SampleBatch batch;
+	NI4050Filter filter;
+	NI4050Autorange autorange;
+	NI4050EepromBlock eepromBlock;
+	int clockId;
+	int value = 0;
+	int nonblock = filp->f_flags & O_NONBLOCK;
+
+	if (!file->controller) {
+		rc = subscriberIoctl(file, cmd, argp, nonblock);
+		if (rc != -ENOIOCTLCMD)
+			return rc;
+	}
+
+	// takes the mutexes of all the cards of the group itself
+	if (cmd == NIDMM_IOCGROUPSTART)
+		return groupStart(argp);
+
+	// a non-blocking read does not queue up behind a blocked one either
+	if (nonblock && (cmd == NIDMM_IOCREADRAW || cmd == NIDMM_IOCREADSAMPLES)) {
+		if (!mutex_trylock(&dev->mutex))
+			return -EAGAIN;
+	} else
+		mutex_lock(&dev->mutex);
+	rc = -ENODEV;
+	if (dev->removed || !pcmcia_dev_present(dev->p_dev)) {
+		pr_debug("DEV_OK false\n");
+		goto out;
+	}
+
+	rc = -EINVAL;
+
+	size = _IOC_SIZE(cmd);
+	rc = -EFAULT;
+	pr_debug("iocdir=%.4x iocr=%.4x iocw=%.4x iocsize=%d cmd=%.4x\n",
+		   _IOC_DIR(cmd), _IOC_READ, _IOC_WRITE, size, cmd);
+
+	if (_IOC_DIR(cmd) & _IOC_READ) {
+		if (!access_ok(VERIFY_WRITE, argp, size))
+			goto out;
+	}
+
+	if (_IOC_DIR(cmd) & _IOC_WRITE) {
+		if (!access_ok(VERIFY_READ, argp, size))
+			goto out;
+	}
+
+	rc = 0;
+
+	switch (cmd) {
+	case NIDMM_IOCEEPROMREAD:
+		if (copy_from_user(&eepromInfo, argp, sizeof(eepromInfo))) {
+			rc = -EFAULT;
+			break;
+		}
+		if (eepromInfo.address >= NI4050_EEPROM_SIZE) {
+			rc = -EINVAL;
+			break;
+		}
+		if (!dev->core.eepromValid) {
+			rc = -EIO;
+			break;
+		}
+		eepromInfo.data = dev->core.eeprom[eepromInfo.address];
+		if (copy_to_user(argp, &eepromInfo, sizeof(eepromInfo)))
+			rc = -EFAULT;
+		break;
+	case NIDMM_IOCEEPROMREADBLOCK:
+		if (copy_from_user(&eepromBlock, argp, sizeof(eepromBlock))) {
+			rc = -EFAULT;
+			break;
+		}
+		if (eepromBlock.address >= NI4050_EEPROM_SIZE) {
+			rc = -EINVAL;
+			break;
+		}
+		if (!dev->core.eepromValid) {
+			rc = -EIO;
+			break;
+		}
+		eepromBlock.length = min_t(u32, eepromBlock.length, NI4050_EEPROM_SIZE - eepromBlock.address);
+		if (copy_to_user((void __user *)(unsigned long)eepromBlock.data,
+				dev->core.eeprom + eepromBlock.address, eepromBlock.length) ||
+			copy_to_user(argp, &eepromBlock, sizeof(eepromBlock)))
+			rc = -EFAULT;
+		break;
+	case NIDMM_IOCEEPROMWRITE:
+		rc = -1;
+		break;
+	case NIDMM_IOCEEPROMREADINTRES:
+		dIntResistorValue = (unsigned int*) arg;
+		*dIntResistorValue = dev->core.dIntResistorValue;
+		break;
+	case NIDMM_IOCSTARTMEASUREMENT:
+		range = (NI4050_RANGES *)arg;
+		stopAutorange(dev);
+		rc = switchRange(dev, *range);
+		break;
+	case NIDMM_IOCSETAUTORANGE:
+		if (copy_from_user(&autorange, argp, sizeof(autorange))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = setAutorange(dev, &autorange);
+		break;
+	case NIDMM_IOCREADRAW:
+		rc = measurmentDataRead(dev, &value, !nonblock);
+		if (rc)
+			goto out;
+		rc = put_user(value, (unsigned int __user *)argp);
+		break;
+	case NIDMM_IOCSETCLOCK:
+		rc = get_user(clockId, (int __user *)argp);
+		if (rc)
+			break;
+		if (clockId != CLOCK_MONOTONIC && clockId != CLOCK_BOOTTIME && clockId != CLOCK_TAI) {
+			rc = -EINVAL;
+			break;
+		}
+		spin_lock_irq(&dev->lock);
+		dev->clockId = clockId;
+		spin_unlock_irq(&dev->lock);
+		break;
+	case NIDMM_IOCSETFILTER:
+		if (copy_from_user(&filter, argp, sizeof(filter))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = setFilter(&dev->core, &filter);
+		if (!rc && copy_to_user(argp, &filter, sizeof(filter)))
+			rc = -EFAULT;
+		break;
+	case NIDMM_IOCGETSCALE:
+		if (copy_from_user(&scale, argp, sizeof(scale))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = getConvertScale(&dev->core, &scale);
+		if (!rc && copy_to_user(argp, &scale, sizeof(scale)))
+			rc = -EFAULT;
+		break;
+	case NIDMM_IOCSETCONTINUOUS:
+		if (copy_from_user(&continuousMode, argp, sizeof(continuousMode))) {
+			rc = -EFAULT;
+			break;
+		}
+		if (continuousMode.overrunPolicy > NI4050_OVERRUN_DROP_NEWEST) {
+			rc = -EINVAL;
+			break;
+		}
+		stopContinuous(dev);
+		if (continuousMode.enable)
+			startContinuous(file, continuousMode.overrunPolicy);
+		break;
+	case NIDMM_IOCGETOVERRUNS:
+		spin_lock_irq(&dev->lock);
+		value = file->overruns;
+		spin_unlock_irq(&dev->lock);
+		rc = put_user(value, (unsigned int __user *)argp);
+		break;
+	case NIDMM_IOCRELOADCALIBRATION:
+		rc = loadCalibration(&dev->core);
+		break;
+	case NIDMM_IOCREADSAMPLES:
+		if (copy_from_user(&batch, argp, sizeof(batch))) {
+			rc = -EFAULT;
+			break;
+		}
+		rc = readSamples(file, &batch, nonblock);
+		if (!rc && copy_to_user(argp, &batch, sizeof(batch)))
+			rc = -EFAULT;
+		break;
+	case NIDMM_IOCGETSWITCHSTATS:
+		if (copy_to_user(argp, &dev->core.switchStats, sizeof(dev->core.switchStats)))
+			rc = -EFAULT;
+		break;
+	default:
+		pr_debug("... in default (unknown IOCTL code)\n");
+		rc = -ENOTTY;
+	}
+out:
+	mutex_unlock(&dev->mutex);
+	return rc;
+}
+
+// Hand out the stream, to the controller in continuous mode only
+static ssize_t ni4050_read(struct file *filp, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct ni4050_file *file = filp->private_data;
+	struct ni4050_dev *dev = file->dev;
+	NI4050Sample samples[16];
+	size_t done = 0;
+	unsigned int n;
+	int ret;
+
+	if (count < sizeof(NI4050Sample))
+		return -EINVAL;
+
+	if (file->controller && !dev->continuous)
+		return -EINVAL;
+
+	if (streamEmpty(dev, file)) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		if (!file->controller)
+			streamKick(dev);
+		ret = wait_event_interruptible(dev->readq,
+				!streamEmpty(dev, file) || dev->removed ||
+				(file->controller && !dev->continuous));
+		if (ret)
+			return ret;
+		if (dev->removed)
+			return -ENODEV;
+		// not an end of file, continuous mode may be turned on again
+		if (file->controller && !dev->continuous)
+			return -EINVAL;
+	}
+
+	while (done + sizeof(NI4050Sample) <= count) {
+		n = min_t(size_t, ARRAY_SIZE(samples), (count - done) / sizeof(NI4050Sample));
+		spin_lock_irq(&dev->lock);
+		n = streamRead(dev, file, samples, n);
+		spin_unlock_irq(&dev->lock);
+		if (n == 0)
+			break;
+
+		if (copy_to_user(buf + done, samples, n * sizeof(NI4050Sample)))
+			return -EFAULT;
+		done += n * sizeof(NI4050Sample);
+	}
+
+	return done;
+}
+
+static unsigned int ni4050_poll(struct file *filp, poll_table *wait)
+{
+	struct ni4050_file *file = filp->private_data;
+	struct ni4050_dev *dev = file->dev;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &dev->readq, wait);
+
+	if (dev->removed)
+		return POLLERR | POLLHUP;
+
+	spin_lock_irq(&dev->lock);
+	if (!file->controller) {
+		if (dev->streamHead != file->cursor)
+			mask |= POLLIN | POLLRDNORM;
+	} else if (dev->continuous) {
+		if (!streamEmpty(dev, file))
+			mask |= POLLIN | POLLRDNORM;
+		if (dev->ring && dev->ringHead != ACCESS_ONCE(dev->ring->tail))
+			mask |= POLLIN | POLLRDNORM;
+	} else if (dev->newData) {
+		// a single conversion for NIDMM_IOCREADRAW or NIDMM_IOCREADSAMPLES
+		mask |= POLLIN | POLLRDNORM;
+	}
+	spin_unlock_irq(&dev->lock);
+
+	// without an irq nothing latches the conversion unless we poll for it
+	if (!mask)
+		streamKick(dev);
+
+	return mask;
+}
+
+// Map the sample ring of the controller, allocated on the first mmap()
+static int ni4050_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ni4050_file *file = filp->private_data;
+	struct ni4050_dev *dev = file->dev;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	NI4050RingHeader *ring;
+	u32 capacity;
+	int ret = 0;
+
+	// the ring has a single tail
+	if (!file->controller)
+		return -EPERM;
+
+	if (vma->vm_pgoff != 0 || size <= PAGE_SIZE || size > NI4050_RING_MAX_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_EXEC)
+		return -EPERM;
+
+	mutex_lock(&dev->mutex);
+	if (dev->removed) {
+		ret = -ENODEV;
+		goto out;
+	}
+	if (dev->ring) {
+		if (size != dev->ringSize)
+			ret = -EBUSY;
+		goto map;
+	}
+
+	capacity = rounddown_pow_of_two((size - PAGE_SIZE) / sizeof(NI4050Sample));
+	ring = vmalloc_user(size);
+	if (ring == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ring->magic = NI4050_RING_MAGIC;
+	ring->recordSize = sizeof(NI4050Sample);
+	ring->capacity = capacity;
+	ring->recordOffset = PAGE_SIZE;
+
+	spin_lock_irq(&dev->lock);
+	dev->ringRecords = (NI4050Sample *)((char *)ring + PAGE_SIZE);
+	dev->ringSize = size;
+	dev->ringHead = 0;
+	dev->ringCapacity = capacity;
+	dev->ring = ring;
+	spin_unlock_irq(&dev->lock);
+
+map:
+	if (!ret)
+		ret = remap_vmalloc_range(vma, dev->ring, 0);
+out:
+	mutex_unlock(&dev->mutex);
+	return ret;
+}
+
+// Detach the ring from the data path, the pages live on while still mapped
+static void freeRing(struct ni4050_dev *dev)
+{
+	NI4050RingHeader *ring;
+
+	spin_lock_irq(&dev->lock);
+	ring = dev->ring;
+	dev->ring = NULL;
+	spin_unlock_irq(&dev->lock);
+
+	vfree(ring);
+}
+
+static void ni4050_free(struct kref *kref)
+{
+	struct ni4050_dev *dev = container_of(kref, struct ni4050_dev, kref);
+
+	kfree_rcu(dev, rcu);
+}
+
+// Take a reference of the card behind a minor, NULL if there is none
+static struct ni4050_dev *ni4050_get(int minor)
+{
+	struct ni4050_dev *dev;
+
+	rcu_read_lock();
+	dev = idr_find(&ni4050_idr, minor);
+	if (dev && !kref_get_unless_zero(&dev->kref))
+		dev = NULL;
+	rcu_read_unlock();
+
+	return dev;
+}
+
+// Opening for writing makes the controller, there is one at a time.
+// Read-only opens subscribe to the conversions from now on.
+static int ni4050_open(struct inode *inode, struct file *filp)
+{
+	struct ni4050_dev *dev;
+	struct ni4050_file *file;
+	int minor = iminor(inode);
+	int ret = 0;
+
+	pr_debug("-> ni4050_open\n");
+	file = kzalloc(sizeof(*file), GFP_KERNEL);
+	if (file == NULL)
+		return -ENOMEM;
+
+	dev = ni4050_get(minor);
+	if (dev == NULL) {
+		pr_debug("-> ni4050 ENODEV\n");
+		kfree(file);
+		return -ENODEV;
+	}
+
+	file->dev = dev;
+	file->controller = (filp->f_mode & FMODE_WRITE) != 0;
+
+	mutex_lock(&dev->mutex);
+	if (dev->removed || !pcmcia_dev_present(dev->p_dev)) {
+		pr_debug("-> ni4050 ENODEV\n");
+		ret = -ENODEV;
+	} else if (file->controller && dev->controller) {
+		pr_debug("-> ni4050 already controlled\n");
+		ret = -EBUSY;
+	} else {
+		spin_lock_irq(&dev->lock);
+		file->cursor = dev->streamHead;
+		if (file->controller)
+			dev->controller = file;
+		spin_unlock_irq(&dev->lock);
+	}
+	mutex_unlock(&dev->mutex);
+
+	if (ret) {
+		kref_put(&dev->kref, ni4050_free);
+		kfree(file);
+		return ret;
+	}
+
+	// the file holds the reference until ni4050_close()
+	filp->private_data = file;
+
+	pr_debug("-> ni4050_open(device=%d.%d process=%s,%d)\n",
+		   imajor(inode), minor, current->comm, current->pid);
+
+	pr_debug("<- ni4050_open\n");
+	return nonseekable_open(inode, filp);
+}
+
+static int ni4050_close(struct inode *inode, struct file *filp)
+{
+	struct ni4050_file *file = filp->private_data;
+	struct ni4050_dev *dev = file->dev;
+
+	pr_debug("-> ni4050_close(maj/min=%d.%d)\n", imajor(inode), iminor(inode));
+
+	if (file->controller) {
+		mutex_lock(&dev->mutex);
+		stopContinuous(dev);
+		freeRing(dev);
+		spin_lock_irq(&dev->lock);
+		dev->controller = NULL;
+		spin_unlock_irq(&dev->lock);
+		mutex_unlock(&dev->mutex);
+	}
+	kfree(file);
+
+	// the last close after a detach frees the card
+	kref_put(&dev->kref, ni4050_free);
+
+	pr_debug("ni4050_close\n");
+	return 0;
+}
+
+/*==== debugfs ========================================================*/
+
+static int ni4050_waitHistogramShow(struct seq_file *m, void *unused)
+{
+	struct ni4050_dev *dev = m->private;
+	u32 histogram[NI4050_WAIT_BUCKETS];
+	int i;
+
+	spin_lock_irq(&dev->lock);
+	memcpy(histogram, dev->stats.waitHistogram, sizeof(histogram));
+	spin_unlock_irq(&dev->lock);
+
+	for (i = 0; i < NI4050_WAIT_BUCKETS - 1; i++)
+		seq_printf(m, "<%lu us\t%u\n", 1UL << i, histogram[i]);
+	seq_printf(m, ">=%lu us\t%u\n", 1UL << (i - 1), histogram[i]);
+	return 0;
+}
+
+static int ni4050_waitHistogramOpen(struct inode *inode, struct file *file)
+{
+	return single_open(file, ni4050_waitHistogramShow, inode->i_private);
+}
+
+static const struct file_operations ni4050_waitHistogramFops = {
+	.owner		= THIS_MODULE,
+	.open		= ni4050_waitHistogramOpen,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+// The counters are read without the lock, a torn 64-bit value on a 32-bit
+// machine is acceptable for diagnostics
+static void ni4050_debugfsInit(struct ni4050_dev *dev)
+{
+	char name[16];
+
+	if (IS_ERR_OR_NULL(ni4050_debugfs))
+		return;
+
+	snprintf(name, sizeof(name), "nidmm%d", dev->devno);
+	dev->debugfs = debugfs_create_dir(name, ni4050_debugfs);
+	if (IS_ERR_OR_NULL(dev->debugfs))
+		return;
+
+	debugfs_create_u64("samples", 0444, dev->debugfs, &dev->stats.samples);
+	debugfs_create_u64("overflows", 0444, dev->debugfs, &dev->stats.overflows);
+	debugfs_create_u32("adc_ready_timeouts", 0444, dev->debugfs, &dev->core.adcTimeouts);
+	debugfs_create_u64("range_switches", 0444, dev->debugfs, &dev->stats.switches);
+	debugfs_create_u64("range_switch_ns_last", 0444, dev->debugfs, &dev->stats.switchNsLast);
+	debugfs_create_u64("range_switch_ns_max", 0444, dev->debugfs, &dev->stats.switchNsMax);
+	debugfs_create_u64("group_starts", 0444, dev->debugfs, &dev->stats.groupStarts);
+	debugfs_create_u64("group_skew_ns_last", 0444, dev->debugfs, &dev->stats.groupSkewNsLast);
+	debugfs_create_u64("group_skew_ns_max", 0444, dev->debugfs, &dev->stats.groupSkewNsMax);
+	debugfs_create_file("wait_histogram", 0444, dev->debugfs, dev, &ni4050_waitHistogramFops);
+}
+
+/*==== sysfs ==========================================================*/
+
+// The EEPROM image cached by loadCalibration(), the card is not touched
+static ssize_t ni4050_eepromRead(struct file *filp, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct ni4050_dev *dev = dev_get_drvdata(container_of(kobj, struct device, kobj));
+	ssize_t ret = count;
+
+	mutex_lock(&dev->mutex);
+	if (dev->core.eepromValid)
+		memcpy(buf, dev->core.eeprom + off, count);
+	else
+		ret = -EIO;
+	mutex_unlock(&dev->mutex);
+
+	return ret;
+}
+
+static struct bin_attribute ni4050_eepromAttr = {
+	.attr	= { .name = "eeprom", .mode = 0444 },
+	.size	= NI4050_EEPROM_SIZE,
+	.read	= ni4050_eepromRead,
+};
+
+/*==== Interface to PCMCIA Layer =======================================*/
+
+static int ni4050_config_check(struct pcmcia_device *p_dev, void *priv_data)
+{
+	pr_debug("-> ni4050_config_check\n");
+	return pcmcia_request_io(p_dev);
+}
+
+static int ni4050_config(struct pcmcia_device * link, int devno)
+{
+	struct ni4050_dev *dev;
+	int iobase = -1;
+
+	pr_debug("-> ni4050_config\n");
+	link->config_flags |= CONF_AUTO_SET_IO | CONF_ENABLE_IRQ;
+
+	/* read the config-tuples */
+	if (pcmcia_loop_config(link, ni4050_config_check, NULL))
+		goto cs_release;
+
+	dev = link->priv;
+
+	/* the card works without an interrupt too, we poll then */
+	if (pcmcia_request_irq(link, ni4050_interrupt))
+		dev->irq = 0;
+	else
+		dev->irq = link->irq;
+	initCommand(&dev->core, dev->irq);
+
+	if (pcmcia_enable_device(link))
+		goto cs_release;
+
+	iobase = dev->p_dev->resource[0]->start;
+
+	pr_debug("<- ni4050 iobase: %d irq: %d\n", iobase, dev->irq);
+	loadCalibration(&dev->core);
+	/*	for (; i<255; i++)
+		pr_debug("%03d == %02x\n",i, readEEPROM(&dev->core, i));*/
+	pr_debug("<- ni4050_config OK\n");
+	return 0;
+
+cs_release:
+	pr_debug("<- ni4050_config NODEV\n");
+	ni4050_release(link);
+	return -ENODEV;
+}
+
+static int ni4050_suspend(struct pcmcia_device *link)
+{
+	struct ni4050_dev *dev;
+	pr_debug("-> ni4050_suspend\n");
+	dev = link->priv;
+
+	return 0;
+}
+
+static int ni4050_resume(struct pcmcia_device *link)
+{
+	struct ni4050_dev *dev;
+	pr_debug("-> ni4050_resume\n");
+	dev = link->priv;
+
+	/* the ADC lost its setup, program it from scratch next time */
+	dev->core.liveValid = 0;
+
+	return 0;
+}
+
+// Open files keep the struct ni4050_dev, not the card, the release does
+// not wait for them
+static void ni4050_release(struct pcmcia_device *link)
+{
+	pcmcia_disable_device(link);
+}
+
+static int ni4050_probe(struct pcmcia_device *link)
+{
+	struct ni4050_dev *dev;
+	int i, ret;
+
+	/* create a new ni4050_cs device */
+	dev = kzalloc(sizeof(struct ni4050_dev), GFP_KERNEL);
+	if (dev == NULL)
+		return -ENOMEM;
+
+	// reserve the lowest free minor, open() finds the card once it is set up
+	mutex_lock(&ni4050_mutex);
+	i = idr_alloc(&ni4050_idr, NULL, 0, NI4050_MINORS, GFP_KERNEL);
+	mutex_unlock(&ni4050_mutex);
+	if (i < 0) {
+		pr_debug(KERN_NOTICE MODULE_NAME ": all devices in use\n");
+		kfree(dev);
+		return i == -ENOSPC ? -ENODEV : i;
+	}
+
+	dev->p_dev = link;
+	dev->devno = i;
+	link->priv = dev;
+
+	kref_init(&dev->kref);
+	mutex_init(&dev->mutex);
+	spin_lock_init(&dev->lock);
+	dev->core.ops = &ni4050_pcmciaOps;
+	dev->core.priv = dev;
+	dev->clockId = CLOCK_MONOTONIC;
+	initFilters(&dev->core);
+	init_waitqueue_head(&dev->readq);
+	INIT_DELAYED_WORK(&dev->pollWork, ni4050_pollWork);
+	INIT_WORK(&dev->rangeWork, ni4050_rangeWork);
+
+	ret = ni4050_config(link, i);
+	if (ret) {
+		mutex_lock(&ni4050_mutex);
+		idr_remove(&ni4050_idr, i);
+		mutex_unlock(&ni4050_mutex);
+		kfree(dev);
+		return ret;
+	}
+
+	mutex_lock(&ni4050_mutex);
+	idr_replace(&ni4050_idr, dev, i);
+	mutex_unlock(&ni4050_mutex);
+
+	dev->device = device_create(ni4050_class, NULL, MKDEV(major, i), dev, "nidmm%d", i);
+	if (IS_ERR(dev->device))
+		dev->device = NULL;
+	// the driver works without it
+	else if (device_create_bin_file(dev->device, &ni4050_eepromAttr))
+		pr_debug(KERN_NOTICE MODULE_NAME ": no eeprom attribute\n");
+	ni4050_debugfsInit(dev);
+	pr_debug("<- ni4050_probe OK\n");
+	return 0;
+}
+
+static void ni4050_detach(struct pcmcia_device *link)
+{
+	struct ni4050_dev *dev = link->priv;
+	int devno = dev->devno;
+	pr_debug("-> ni4050_detach\n");
+
+	// no new opens, the open files keep dev until they are closed
+	mutex_lock(&ni4050_mutex);
+	idr_remove(&ni4050_idr, devno);
+	mutex_unlock(&ni4050_mutex);
+
+	// kick out the sleepers, they may hold the mutex
+	spin_lock_irq(&dev->lock);
+	dev->removed = 1;
+	spin_unlock_irq(&dev->lock);
+	wake_up_interruptible(&dev->readq);
+
+	mutex_lock(&dev->mutex);
+	stopAutorange(dev);
+	stopContinuous(dev);
+	mutex_unlock(&dev->mutex);
+
+	/* stop the conversion interrupts before the line is freed */
+	if (dev->irq)
+		ni4050_coreOutb(&dev->core, NI4050_COMMAND_DEFAULT, NI4050_COMMAND_REG);
+	cancel_work_sync(&dev->rangeWork);
+	// nothing queues it again once removed is set
+	cancel_delayed_work_sync(&dev->pollWork);
+	debugfs_remove_recursive(dev->debugfs);
+
+	// waits for the readers of the eeprom attribute
+	if (dev->device)
+		device_remove_bin_file(dev->device, &ni4050_eepromAttr);
+	ni4050_release(link);
+	device_destroy(ni4050_class, MKDEV(major, devno));
+
+	kref_put(&dev->kref, ni4050_free);
+
+	return;
+}
+
+static const struct file_operations ni4050_fops = {
+	.owner	= THIS_MODULE,
+	.unlocked_ioctl	= ni4050_ioctl,
+	.read	= ni4050_read,
+	.poll	= ni4050_poll,
+	.mmap	= ni4050_mmap,
+	.open	= ni4050_open,
+	.release= ni4050_close,
+};
+
+static struct pcmcia_device_id ni4050_ids[] = {
+	PCMCIA_DEVICE_MANF_CARD(0x010b, 0x011a),
+	//PCMCIA_DEVICE_PROD_ID12("National Instruments", "DAQCard-4050", 0x2FB368CA, 0xA2BD8C39),
+	PCMCIA_DEVICE_NULL,
+};
+MODULE_DEVICE_TABLE(pcmcia, ni4050_ids);
+
+static struct pcmcia_driver ni4050_driver = {
+	.owner	  = THIS_MODULE,
+	.name	  = "ni4050",
+	.probe	= ni4050_probe,
+	.remove   = ni4050_detach,
+	.suspend  = ni4050_suspend,
+	.resume   = ni4050_resume,
+	.id_table = ni4050_ids,
+};
+
+static int __init ni4050_init(void)
+{
+	int rc;
+
+	ni4050_class = class_create(THIS_MODULE, "ni_4050");
+	if (IS_ERR(ni4050_class))
+		return PTR_ERR(ni4050_class);
+
+	// the driver works without it
+	ni4050_debugfs = debugfs_create_dir("ni4050", NULL);
+
+	major = register_chrdev(0, DEVICE_NAME, &ni4050_fops);
+	if (major < 0) {
+		pr_debug(KERN_WARNING MODULE_NAME
+			   ": could not get major number\n");
+		debugfs_remove_recursive(ni4050_debugfs);
+		class_destroy(ni4050_class);
+		return major;
+	}
+
+	rc = pcmcia_register_driver(&ni4050_driver);
+	if (rc < 0) {
+		unregister_chrdev(major, DEVICE_NAME);
+		debugfs_remove_recursive(ni4050_debugfs);
+		class_destroy(ni4050_class);
+		return rc;
+	}
+
+	return 0;
+}
+
+static void __exit ni4050_exit(void)
+{
+	pcmcia_unregister_driver(&ni4050_driver);
+	unregister_chrdev(major, DEVICE_NAME);
+	debugfs_remove_recursive(ni4050_debugfs);
+	class_destroy(ni4050_class);
+	idr_destroy(&ni4050_idr);
+};
+
+module_init(ni4050_init);
+module_exit(ni4050_exit);
+MODULE_LICENSE("Dual BSD/GPL");
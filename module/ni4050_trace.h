@@ -0,0 +1,131 @@
+/*
+  * Tracepoints of the National Instruments PCMCIA 4050 driver
+  *
+  * ni4050_trace.h
+  *
+  * The events cost a patched out branch while they are off, enable them
+  * at run time under /sys/kernel/debug/tracing/events/ni4050/.
+  */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ni4050
+
+#if !defined(NI4050_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define NI4050_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#include "ni4050.h"
+
+#define show_ni4050_read_reg(reg) __print_symbolic(reg,		\
+		{ NI4050_STATUS_REG,		"STATUS" },		\
+		{ NI4050_ADC_DATA1_REG,		"ADC_DATA1" },		\
+		{ NI4050_ADC_DATA2_REG,		"ADC_DATA2" },		\
+		{ NI4050_ADC_DATA3_REG,		"ADC_DATA3" },		\
+		{ NI4050_EEPROM_DATA_REG,	"EEPROM_DATA" })
+
+#define show_ni4050_write_reg(reg) __print_symbolic(reg,	\
+		{ NI4050_COMMAND_REG,		"COMMAND" },		\
+		{ NI4050_ADC_COMMAND_REG,	"ADC_COMMAND" },	\
+		{ NI4050_ADC_WRITE_REG,		"ADC_WRITE" },		\
+		{ NI4050_CONFIG_REG,		"CONFIG" },		\
+		{ NI4050_EEPROM_ADDR1_REG,	"EEPROM_ADDR1" },	\
+		{ NI4050_EEPROM_ADDR2_REG,	"EEPROM_ADDR2" },	\
+		{ NI4050_EEPROM_DATA_REG,	"EEPROM_DATA" })
+
+DECLARE_EVENT_CLASS(ni4050_reg,
+	TP_PROTO(int devno, unsigned int reg, unsigned char val),
+	TP_ARGS(devno, reg, val),
+
+	TP_STRUCT__entry(
+		__field(int, devno)
+		__field(unsigned int, reg)
+		__field(unsigned char, val)
+	),
+
+	TP_fast_assign(
+		__entry->devno = devno;
+		__entry->reg = reg;
+		__entry->val = val;
+	),
+
+	TP_printk("nidmm%d reg=%u val=0x%02x", __entry->devno, __entry->reg, __entry->val)
+);
+
+DEFINE_EVENT_PRINT(ni4050_reg, ni4050_reg_read,
+	TP_PROTO(int devno, unsigned int reg, unsigned char val),
+	TP_ARGS(devno, reg, val),
+	TP_printk("nidmm%d %s = 0x%02x", __entry->devno,
+		show_ni4050_read_reg(__entry->reg), __entry->val)
+);
+
+DEFINE_EVENT_PRINT(ni4050_reg, ni4050_reg_write,
+	TP_PROTO(int devno, unsigned int reg, unsigned char val),
+	TP_ARGS(devno, reg, val),
+	TP_printk("nidmm%d %s <- 0x%02x", __entry->devno,
+		show_ni4050_write_reg(__entry->reg), __entry->val)
+);
+
+TRACE_EVENT(ni4050_range_switch,
+	TP_PROTO(int devno, int from, int to, int rc, u64 ns,
+		const NI4050SwitchStats *stats),
+	TP_ARGS(devno, from, to, rc, ns, stats),
+
+	TP_STRUCT__entry(
+		__field(int, devno)
+		__field(int, from)
+		__field(int, to)
+		__field(int, rc)
+		__field(u64, ns)
+		__field(u32, portIO)
+		__field(u32, fullReset)
+	),
+
+	TP_fast_assign(
+		__entry->devno = devno;
+		__entry->from = from;
+		__entry->to = to;
+		__entry->rc = rc;
+		__entry->ns = ns;
+		__entry->portIO = stats->portIO;
+		__entry->fullReset = stats->fullReset;
+	),
+
+	TP_printk("nidmm%d range %d -> %d rc=%d %llu ns, %u port I/O%s",
+		__entry->devno, __entry->from, __entry->to, __entry->rc,
+		(unsigned long long)__entry->ns, __entry->portIO,
+		__entry->fullReset ? ", full reset" : "")
+);
+
+TRACE_EVENT(ni4050_sample,
+	TP_PROTO(int devno, const NI4050Sample *sample),
+	TP_ARGS(devno, sample),
+
+	TP_STRUCT__entry(
+		__field(int, devno)
+		__field(u64, timestamp)
+		__field(u32, value)
+		__field(u8, status)
+		__field(u8, range)
+	),
+
+	TP_fast_assign(
+		__entry->devno = devno;
+		__entry->timestamp = sample->timestamp;
+		__entry->value = sample->value;
+		__entry->status = sample->status;
+		__entry->range = sample->range;
+	),
+
+	TP_printk("nidmm%d range=%u value=0x%06x status=0x%02x timestamp=%llu",
+		__entry->devno, __entry->range, __entry->value, __entry->status,
+		(unsigned long long)__entry->timestamp)
+);
+
+#endif /* NI4050_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ni4050_trace
+#include <trace/define_trace.h>
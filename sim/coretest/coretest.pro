@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Checks of the driver core against the simulated card
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = coretest
+TEMPLATE = app
+CONFIG += console
+
+OBJECTS_DIR = build
+DESTDIR = bin
+
+
+SOURCES += main.cpp
+
+LIBS += -L../lib -lni4050sim
+PRE_TARGETDEPS += ../lib/libni4050sim.a
@@ -0,0 +1,238 @@
+// Checks of the driver core against the simulated card
+//
+// - every range and filter preset programs the calibration words of its
+//   own EEPROM block, whatever range the card came from
+// - a switch resets the ADC only on a change of measurement family and
+//   otherwise writes just the register groups which differ
+// - autorangeNext() steps at the up and down thresholds
+// - the conversion interrupt is off while the ADC is reprogrammed, back on
+//   once it runs and raised by every completed conversion
+//
+// usage: coretest
+// Prints the failed checks and exits with 1 if there were any.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../ni4050sim.h"
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+        } \
+    } while (0)
+
+static void setUp(Ni4050Simulator *sim, struct ni4050_core *core)
+{
+    memset(core, 0, sizeof(*core));
+    sim->attach(core);
+    initCommand(core, 1);
+    initFilters(core);
+    CHECK(loadCalibration(core) == 0, "loading the calibration failed");
+}
+
+static void setPreset(struct ni4050_core *core, int range, unsigned int preset)
+{
+    NI4050Filter filter;
+
+    filter.range = range;
+    filter.filterCode = 0;
+    filter.preset = preset;
+    CHECK(setFilter(core, &filter) == 0, "range %d preset %u rejected", range, preset);
+}
+
+static void checkCalibration()
+{
+    Ni4050Simulator sim;
+    struct ni4050_core core;
+
+    setUp(&sim, &core);
+
+    for (unsigned int preset = 0; preset < NI4050_FILTER_PRESETS; preset++) {
+        for (int range = 0; range < NI4050_RANGE_COUNT; range++)
+            setPreset(&core, range, preset);
+
+        for (int range = 0; range < NI4050_RANGE_COUNT; range++) {
+            for (int from = 0; from < NI4050_RANGE_COUNT; from++) {
+                if (startMeasurment(&core, (NI4050_RANGES)from) ||
+                    startMeasurment(&core, (NI4050_RANGES)range)) {
+                    CHECK(0, "switch from %d to %d failed", from, range);
+                    continue;
+                }
+                CHECK(sim.range() == range, "range %d from %d set up as %d", range, from, sim.range());
+                CHECK(sim.calibrationMatches((NI4050_RANGES)range, preset),
+                      "range %d preset %u from %d runs on calibration %06x/%06x",
+                      range, preset, from, sim.zeroCalibration(), sim.fullCalibration());
+            }
+        }
+    }
+}
+
+static void checkSwitchCost()
+{
+    Ni4050Simulator sim;
+    struct ni4050_core core;
+    const NI4050SwitchStats *stats = &core.switchStats;
+
+    setUp(&sim, &core);
+
+    // the first start programs everything
+    CHECK(startMeasurment(&core, NI4050_RANGE_2VDC) == 0, "start of 2VDC failed");
+    CHECK(stats->fullReset == 1, "first start without reset");
+    CHECK(stats->registerWrites == NI4050_SEQUENCE_MAX, "first start wrote %u registers", stats->registerWrites);
+
+    // a restart only releases the filter and sets the card to read
+    CHECK(startMeasurment(&core, NI4050_RANGE_2VDC) == 0, "restart of 2VDC failed");
+    CHECK(stats->fullReset == 0, "restart reset the ADC");
+    CHECK(stats->registerWrites == 3, "restart wrote %u registers", stats->registerWrites);
+
+    // same family, the differing groups only
+    CHECK(startMeasurment(&core, NI4050_RANGE_200mVDC) == 0, "switch to 200mVDC failed");
+    CHECK(stats->fullReset == 0, "switch within DC volts reset the ADC");
+    CHECK(stats->registerWrites > 3 && stats->registerWrites < NI4050_SEQUENCE_MAX,
+          "switch within DC volts wrote %u registers", stats->registerWrites);
+    CHECK(stats->portIO < 4 * NI4050_SEQUENCE_MAX, "switch within DC volts took %u port I/O", stats->portIO);
+
+    // another family needs a reset
+    CHECK(startMeasurment(&core, NI4050_RANGE_2kOHM) == 0, "switch to 2kOHM failed");
+    CHECK(stats->fullReset == 1, "switch from volts to ohms without reset");
+    CHECK(stats->registerWrites == NI4050_SEQUENCE_MAX, "switch to ohms wrote %u registers", stats->registerWrites);
+
+    CHECK(sim.range() == NI4050_RANGE_2kOHM, "card set up as %d", sim.range());
+}
+
+static NI4050_RANGES next(const NI4050Autorange *autorange, NI4050_RANGES range, double fraction,
+                          unsigned char status = 0)
+{
+    NI4050Sample sample;
+
+    memset(&sample, 0, sizeof(sample));
+    sample.range = range;
+    sample.status = status;
+    sample.value = (unsigned int)(NI4050_CONVERT_CODE_ZERO + fraction * NI4050_CONVERT_CODE_SPAN);
+    return autorangeNext(autorange, &sample);
+}
+
+static void checkAutorange()
+{
+    NI4050Autorange autorange;
+    const MeasurementData *cur = &measurmentInfo[NI4050_RANGE_2VDC];
+    const MeasurementData *low = &measurmentInfo[NI4050_RANGE_200mVDC];
+    // 800 permille of the 200mVDC full scale in codes of 2VDC
+    double down = 0.8 * low->scaleNum / low->scaleDen * cur->scaleDen / cur->scaleNum;
+
+    autorange.function = NI4050_AUTORANGE_VDC;
+    autorange.upPermille = 950;
+    autorange.downPermille = 800;
+    autorange.settleSamples = 0;
+
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, 0.96) == NI4050_RANGE_25VDC, "no step up above 950");
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, -0.96) == NI4050_RANGE_25VDC, "no step up below -950");
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, 0.94) == NI4050_RANGE_2VDC, "step below 950");
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, 0.5, NI4050_STATUS_OVERFLOW) == NI4050_RANGE_25VDC,
+          "no step up on overflow");
+    CHECK(next(&autorange, NI4050_RANGE_250VDC, 1.0, NI4050_STATUS_OVERFLOW) == NI4050_RANGE_250VDC,
+          "step above the highest range");
+
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, down * 0.99) == NI4050_RANGE_200mVDC, "no step down below 800");
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, -down * 0.99) == NI4050_RANGE_200mVDC, "no step down above -800");
+    CHECK(next(&autorange, NI4050_RANGE_2VDC, down * 1.01) == NI4050_RANGE_2VDC, "step down above 800");
+    CHECK(next(&autorange, NI4050_RANGE_20mVDC, 0) == NI4050_RANGE_20mVDC, "step below the lowest range");
+
+    // a range of another function is left alone
+    CHECK(next(&autorange, NI4050_RANGE_2VAC, 1.0, NI4050_STATUS_OVERFLOW) == NI4050_RANGE_2VAC,
+          "stepped a range of another function");
+}
+
+// Prepare writes: COMMAND_REG without ADCINTEN before anything else, never with it
+static void checkQuiet(const Ni4050Simulator &sim, const char *what)
+{
+    const std::vector<Ni4050Simulator::PortWrite> &log = sim.writeLog();
+    bool quiet = false;
+
+    for (size_t i = 0; i < log.size(); i++) {
+        if (log[i].reg == NI4050_COMMAND_REG) {
+            CHECK(!(log[i].val & NI4050_COMMAND_ADCINTEN), "%s: interrupt enabled at write %u", what, (unsigned)i);
+            quiet = !(log[i].val & NI4050_COMMAND_ADCINTEN);
+        } else if (!quiet) {
+            CHECK(0, "%s: register %u written with the interrupt on", what, log[i].reg);
+            return;
+        }
+    }
+    CHECK(quiet, "%s: interrupt not turned off", what);
+}
+
+static void checkStart(Ni4050Simulator *sim, struct ni4050_core *core, NI4050_RANGES range, const char *what)
+{
+    sim->setWriteLog(true);
+    CHECK(startMeasurmentPrepare(core, range) == 0, "%s: prepare failed", what);
+    checkQuiet(*sim, what);
+    CHECK(!sim->interruptPending(), "%s: interrupt pending while prepared", what);
+
+    sim->setWriteLog(true);
+    startMeasurmentFire(core);
+    CHECK(startMeasurmentFinish(core) == 0, "%s: finish failed", what);
+    const std::vector<Ni4050Simulator::PortWrite> &log = sim->writeLog();
+    CHECK(!log.empty() && log.back().reg == NI4050_COMMAND_REG && log.back().val == core->command,
+          "%s: finish did not end by writing COMMAND_REG %02x", what, core->command);
+    sim->setWriteLog(false);
+}
+
+static void checkInterrupt()
+{
+    Ni4050Simulator sim;
+    struct ni4050_core core;
+
+    setUp(&sim, &core);
+    CHECK(core.command & NI4050_COMMAND_ADCINTEN, "no conversion interrupt with an irq");
+
+    // full reset, then a delta update while a conversion is pending
+    checkStart(&sim, &core, NI4050_RANGE_2VDC, "start of 2VDC");
+    CHECK(sim.command() & NI4050_COMMAND_ADCINTEN, "interrupt off after the start");
+    CHECK(!sim.interruptPending(), "interrupt before the first conversion");
+    sim.advance(sim.nextConversion() - sim.now());
+    CHECK(sim.interruptPending(), "no interrupt on a conversion");
+    CHECK(measurmentIsReady(&core), "NEW_DATA not set");
+    measurmentDataRegsRead(&core);
+    CHECK(!sim.interruptPending(), "interrupt still pending after the data was read");
+
+    sim.advance(sim.nextConversion() - sim.now());
+    checkStart(&sim, &core, NI4050_RANGE_200mVDC, "switch to 200mVDC");
+    CHECK(core.switchStats.fullReset == 0, "switch within DC volts reset the ADC");
+    sim.advance(sim.nextConversion() - sim.now());
+    CHECK(sim.interruptPending(), "no interrupt after the switch");
+
+    // without an irq the conversion is only flagged in STATUS_REG
+    setUp(&sim, &core);
+    initCommand(&core, 0);
+    sim.setWriteLog(true);
+    CHECK(startMeasurment(&core, NI4050_RANGE_2VDC) == 0, "start without irq failed");
+    for (size_t i = 0; i < sim.writeLog().size(); i++)
+        CHECK(sim.writeLog()[i].reg != NI4050_COMMAND_REG || !(sim.writeLog()[i].val & NI4050_COMMAND_ADCINTEN),
+              "interrupt enabled without an irq");
+    sim.setWriteLog(false);
+    sim.advance(sim.nextConversion() - sim.now());
+    CHECK(!sim.interruptPending(), "interrupt without an irq");
+    CHECK(measurmentIsReady(&core), "NEW_DATA not set without an irq");
+}
+
+int main()
+{
+    checkCalibration();
+    checkSwitchCost();
+    checkAutorange();
+    checkInterrupt();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Range switch and acquisition cost of the driver core
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = driverbench
+TEMPLATE = app
+CONFIG += console
+
+OBJECTS_DIR = build
+DESTDIR = bin
+
+
+SOURCES += main.cpp
+
+LIBS += -L../lib -lni4050sim
+PRE_TARGETDEPS += ../lib/libni4050sim.a
@@ -0,0 +1,177 @@
+// Range switch and acquisition cost of the driver core
+//
+// Runs startMeasurment() and the interrupt path of ni4050_cs.c against the
+// simulated card and prints one JSON document: for every NI4050_RANGES the
+// switch latency, the port I/Os of a switch and of a sample, the sustained
+// sample rate and p50/p99 of the time from the start of a switch to the
+// first sample. Every switch is measured from each of the other ranges, so
+// both the delta and the full reset path show up in the percentiles.
+// After every switch the calibration words the ADC was given must be the
+// ones of the new range's own EEPROM block, otherwise the bench fails.
+//
+// usage: driverbench [ioLatencyNs [runs [samples [filterCode]]]]
+// filterCode 0 keeps the default filter of every range.
+//
+// Time is the virtual time of the simulator, so the numbers only depend on
+// the code and the arguments and can be compared from commit to commit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../ni4050sim.h"
+
+#define RANGE_LABEL(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+		acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    label,
+
+static const char *rangeLabels[NI4050_RANGE_COUNT] = {
+    NI4050_RANGE_TABLE(RANGE_LABEL)
+};
+
+struct Sample {
+    uint64_t value;
+    uint64_t time;
+};
+
+// What the interrupt handler does once NEW_DATA raised the line
+static bool irqSample(Ni4050Simulator *sim, struct ni4050_core *core)
+{
+    uint64_t next = sim->nextConversion();
+
+    if (next == UINT64_MAX)
+        return false;
+    if (next > sim->now())
+        sim->advance(next - sim->now());
+    if (!measurmentIsReady(core))
+        return false;
+    measurmentDataRegsRead(core);
+    return true;
+}
+
+static uint64_t percentile(std::vector<uint64_t> values, double p)
+{
+    size_t i = (size_t)(p * values.size() + 0.999999);
+
+    std::sort(values.begin(), values.end());
+    return values[i ? i - 1 : 0];
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t ioLatency = argc > 1 ? strtoull(argv[1], 0, 0) : 1000;
+    int runs = argc > 2 ? atoi(argv[2]) : 4 * (NI4050_RANGE_COUNT - 1);
+    int samples = argc > 3 ? atoi(argv[3]) : 100;
+    unsigned int filterCode = argc > 4 ? strtoul(argv[4], 0, 0) : 0;
+    Ni4050Simulator sim;
+    Ni4050Simulator::Timing timing = sim.timing();
+    struct ni4050_core core;
+    int failed = 0;
+    int printed = 0;
+
+    if (runs < 1 || samples < 1) {
+        fprintf(stderr, "usage: %s [ioLatencyNs [runs [samples [filterCode]]]]\n", argv[0]);
+        return 2;
+    }
+
+    timing.ioLatencyNs = ioLatency;
+    sim.setTiming(timing);
+
+    memset(&core, 0, sizeof(core));
+    sim.attach(&core);
+    initCommand(&core, 1);
+    initFilters(&core);
+    if (loadCalibration(&core)) {
+        fprintf(stderr, "loading the calibration failed\n");
+        return 1;
+    }
+
+    if (filterCode) {
+        for (int range = 0; range < NI4050_RANGE_COUNT; range++) {
+            NI4050Filter filter;
+            filter.range = range;
+            filter.filterCode = filterCode;
+            filter.preset = NI4050_FILTER_10HZ;
+            if (setFilter(&core, &filter)) {
+                fprintf(stderr, "invalid filter code %u\n", filterCode);
+                return 2;
+            }
+        }
+    }
+
+    printf("{\n");
+    printf("  \"ioLatencyNs\": %llu,\n", (unsigned long long)ioLatency);
+    printf("  \"adcBusyNs\": %llu,\n", (unsigned long long)timing.adcBusyNs);
+    printf("  \"runs\": %d,\n", runs);
+    printf("  \"samples\": %d,\n", samples);
+    printf("  \"filterCode\": %u,\n", filterCode);
+    printf("  \"ranges\": [\n");
+
+    for (int range = 0; range < NI4050_RANGE_COUNT; range++) {
+        std::vector<uint64_t> switchNs, firstSampleNs, switchIo;
+        unsigned int fullResets = 0;
+
+        for (int run = 0; run < runs; run++) {
+            // come from every other range in turn
+            int from = (range + 1 + run % (NI4050_RANGE_COUNT - 1)) % NI4050_RANGE_COUNT;
+            if (startMeasurment(&core, (NI4050_RANGES)from) || !irqSample(&sim, &core)) {
+                failed = 1;
+                continue;
+            }
+
+            uint64_t start = sim.now();
+            uint64_t io = sim.ioCount();
+            if (startMeasurment(&core, (NI4050_RANGES)range) || sim.range() != range) {
+                failed = 1;
+                continue;
+            }
+            if (!sim.calibrationMatches((NI4050_RANGES)range, core.filter[range].preset)) {
+                fprintf(stderr, "range %d from %d runs on calibration %06x/%06x\n",
+                        range, from, sim.zeroCalibration(), sim.fullCalibration());
+                failed = 1;
+            }
+            switchNs.push_back(sim.now() - start);
+            switchIo.push_back(sim.ioCount() - io);
+            fullResets += core.switchStats.fullReset;
+
+            if (!irqSample(&sim, &core)) {
+                failed = 1;
+                continue;
+            }
+            firstSampleNs.push_back(sim.now() - start);
+        }
+
+        // sustained rate once the range is running
+        uint64_t start = sim.now();
+        uint64_t io = sim.ioCount();
+        int read = 0;
+        while (read < samples && irqSample(&sim, &core))
+            read++;
+        uint64_t elapsed = sim.now() - start;
+        if (read < samples || switchNs.empty() || firstSampleNs.empty()) {
+            failed = 1;
+            fprintf(stderr, "range %d failed\n", range);
+            if (switchNs.empty() || firstSampleNs.empty() || !read)
+                continue;
+        }
+
+        // the separator goes before an entry, a failed last range leaves none dangling
+        printf("%s    {\"range\": %d, \"label\": \"%s\", ", printed++ ? ",\n" : "", range, rangeLabels[range]);
+        printf("\"switchNsP50\": %llu, \"switchNsP99\": %llu, ",
+               (unsigned long long)percentile(switchNs, 0.5), (unsigned long long)percentile(switchNs, 0.99));
+        printf("\"switchIoP50\": %llu, \"switchIoMax\": %llu, \"fullResets\": %u, ",
+               (unsigned long long)percentile(switchIo, 0.5), (unsigned long long)percentile(switchIo, 1.0),
+               fullResets);
+        printf("\"firstSampleNsP50\": %llu, \"firstSampleNsP99\": %llu, ",
+               (unsigned long long)percentile(firstSampleNs, 0.5), (unsigned long long)percentile(firstSampleNs, 0.99));
+        printf("\"ioPerSample\": %.2f, \"samplesPerSecond\": %.2f}",
+               (double)(sim.ioCount() - io) / read, read * 1e9 / elapsed);
+    }
+
+    printf("\n  ]\n");
+    printf("}\n");
+
+    return failed;
+}
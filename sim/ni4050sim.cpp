@@ -0,0 +1,361 @@
+#include "ni4050sim.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+unsigned char simInb(void *priv, unsigned int reg)
+{
+    return static_cast<Ni4050Simulator *>(priv)->inb(reg);
+}
+
+void simOutb(void *priv, unsigned char val, unsigned int reg)
+{
+    static_cast<Ni4050Simulator *>(priv)->outb(val, reg);
+}
+
+void simDelay(void *priv, unsigned int ms)
+{
+    static_cast<Ni4050Simulator *>(priv)->delay(ms);
+}
+
+const struct ni4050_ops simOps = {
+    simInb,
+    simOutb,
+    simDelay
+};
+
+const unsigned int eepromModes[] = {
+    NI4050_EEPROM_MODE_VDC, NI4050_EEPROM_MODE_VAC, NI4050_EEPROM_MODE_OHMS, NI4050_EEPROM_MODE_DIODE
+};
+// indexed by NI4050_FILTER_*
+const unsigned int eepromFilters[] = {
+    NI4050_EEPROM_FILTER_10HZ, NI4050_EEPROM_FILTER_50HZ, NI4050_EEPROM_FILTER_60HZ
+};
+
+#define CALIBRATION_BLOCK(range, eepromMode, eepromRange, calFilter, filter, inputRange, ohmsMode, \
+        acRange, ohmsRange, adcMode, scale, flags, unit, label, title) \
+    NI4050_EEPROM_AREA_LOAD + NI4050_EEPROM_MODE_##eepromMode + NI4050_EEPROM_RANGE_##eepromRange,
+
+const unsigned int calibrationBlocks[NI4050_RANGE_COUNT] = {
+    NI4050_RANGE_TABLE(CALIBRATION_BLOCK)
+};
+
+void putWord(unsigned char *eeprom, unsigned int address, unsigned int value)
+{
+    for (int i = 0; i < 3; i++)
+        eeprom[address + i] = (value >> (8 * i)) & 0xFF;
+}
+
+unsigned int getWord(const unsigned char *eeprom, unsigned int address)
+{
+    return eeprom[address] | (eeprom[address + 1] << 8) | (eeprom[address + 2] << 16);
+}
+
+} // namespace
+
+Ni4050Simulator::Ni4050Simulator() :
+    m_now(0),
+    m_ioCount(0),
+    m_conversions(0),
+    m_writeLogEnabled(false),
+    m_input(0),
+    m_noise(0),
+    m_random(4050),
+    m_command(NI4050_COMMAND_DEFAULT),
+    m_config(0),
+    m_eepromAddress(0)
+{
+    m_timing.ioLatencyNs = 1000;
+    m_timing.adcBusyNs = 2000;
+    m_timing.conversionExtraNs = 0;
+    m_timing.settleConversions = 3;
+
+    resetAdc();
+    loadDefaultEeprom();
+}
+
+void Ni4050Simulator::attach(struct ni4050_core *core)
+{
+    core->ops = &simOps;
+    core->priv = this;
+}
+
+void Ni4050Simulator::advance(uint64_t ns)
+{
+    m_now += ns;
+}
+
+uint64_t Ni4050Simulator::nextConversion() const
+{
+    return m_running ? m_nextConversion : UINT64_MAX;
+}
+
+bool Ni4050Simulator::interruptPending()
+{
+    update();
+    return (m_command & NI4050_COMMAND_ADCINTEN) && m_newData;
+}
+
+// Calibration words close to what real cards carry, a little different
+// for every range and filter so mix-ups show up
+void Ni4050Simulator::loadDefaultEeprom(unsigned int intResistance)
+{
+    memset(m_eeprom, 0xFF, sizeof(m_eeprom));
+
+    for (unsigned int m = 0; m < sizeof(eepromModes) / sizeof(eepromModes[0]); m++) {
+        for (unsigned int r = 0; r <= NI4050_EEPROM_RANGE_200OHM; r += 0x20) {
+            for (unsigned int f = 0; f < sizeof(eepromFilters) / sizeof(eepromFilters[0]); f++) {
+                unsigned int offset = eepromModes[m] + r + eepromFilters[f];
+                unsigned int tag = (m << 8) | (r << 2) | f;
+                if (eepromModes[m] == NI4050_EEPROM_MODE_DIODE && r)
+                    continue;
+
+                putWord(m_eeprom, NI4050_EEPROM_AREA_LOAD + offset + NI4050_EEPROM_CAL_ZERO, 0x800000 + tag);
+                putWord(m_eeprom, NI4050_EEPROM_AREA_LOAD + offset + NI4050_EEPROM_CAL_FULL, 0x5a0000 + tag);
+            }
+        }
+    }
+    putWord(m_eeprom, NI4050_EEPROM_AREA_LOAD | NI4050_EEPROM_INTERNAL_RESISTANCE, intResistance);
+
+    // the factory area holds the same constants
+    memcpy(m_eeprom + NI4050_EEPROM_AREA_FACTORY, m_eeprom + NI4050_EEPROM_AREA_LOAD, 0x400);
+}
+
+NI4050_RANGES Ni4050Simulator::range() const
+{
+    for (int i = 0; i < NI4050_MEASUREMENT_COUNT; i++) {
+        const MeasurementData *info = &measurmentInfo[i];
+        if (m_config == (info->inputRange | info->ohmsMode | info->acRange | info->ohmsRange) &&
+            (m_adcMode & 0x1C) == info->gain && m_adcChannel == info->measurmentMode)
+            return (NI4050_RANGES)i;
+    }
+    return NI4050_RANGE_INVALID;
+}
+
+bool Ni4050Simulator::calibrationMatches(NI4050_RANGES range, unsigned int preset) const
+{
+    unsigned int address;
+
+    if (range < 0 || range >= NI4050_RANGE_COUNT || preset >= NI4050_FILTER_PRESETS)
+        return false;
+
+    address = calibrationBlocks[range] + eepromFilters[preset];
+    return m_zeroCal == getWord(m_eeprom, address + NI4050_EEPROM_CAL_ZERO) &&
+        m_fullCal == getWord(m_eeprom, address + NI4050_EEPROM_CAL_FULL);
+}
+
+unsigned char Ni4050Simulator::inb(unsigned int reg)
+{
+    unsigned char val = 0xFF;
+
+    m_now += m_timing.ioLatencyNs;
+    m_ioCount++;
+    update();
+
+    switch (reg) {
+    case NI4050_STATUS_REG:
+        val = NI4050_STATUS_REG_DEFAULT;
+        if (m_now >= m_adcBusyUntil)
+            val |= NI4050_STATUS_ADC_RDY;
+        if (m_newData)
+            val |= NI4050_STATUS_NEW_DATA;
+        if (m_overflow)
+            val |= NI4050_STATUS_OVERFLOW;
+        break;
+    case NI4050_ADC_DATA1_REG:
+    case NI4050_ADC_DATA2_REG:
+    case NI4050_ADC_DATA3_REG:
+        val = (m_data >> (8 * (reg - NI4050_ADC_DATA1_REG))) & 0xFF;
+        // the most significant byte is read last and frees the result
+        if (reg == NI4050_ADC_DATA3_REG)
+            m_newData = false;
+        break;
+    case NI4050_EEPROM_DATA_REG:
+        val = m_eeprom[m_eepromAddress % EepromSize];
+        break;
+    }
+
+    return val;
+}
+
+void Ni4050Simulator::outb(unsigned char val, unsigned int reg)
+{
+    m_now += m_timing.ioLatencyNs;
+    m_ioCount++;
+    update();
+
+    if (m_writeLogEnabled) {
+        PortWrite write = { reg, val };
+        m_writeLog.push_back(write);
+    }
+
+    switch (reg) {
+    case NI4050_COMMAND_REG:
+        m_command = val;
+        break;
+    case NI4050_ADC_COMMAND_REG:
+        m_adcBusyUntil = m_now + m_timing.adcBusyNs;
+        if (val == NI4050_ADC_COMMAND_RESET) {
+            resetAdc();
+            break;
+        }
+        m_adcCommand = val;
+        m_adcByte = 0;
+        break;
+    case NI4050_ADC_WRITE_REG:
+        m_adcBusyUntil = m_now + m_timing.adcBusyNs;
+        adcWrite(val);
+        break;
+    case NI4050_CONFIG_REG:
+        m_config = val;
+        break;
+    case NI4050_EEPROM_ADDR1_REG:
+        m_eepromAddress = (m_eepromAddress & 0xFF00) | val;
+        break;
+    case NI4050_EEPROM_ADDR2_REG:
+        m_eepromAddress = (m_eepromAddress & 0x00FF) | (val << 8);
+        break;
+    case NI4050_EEPROM_DATA_REG:
+        if (m_command & NI4050_COMMAND_EEPROM_WE)
+            m_eeprom[m_eepromAddress % EepromSize] = val;
+        break;
+    }
+}
+
+void Ni4050Simulator::delay(unsigned int ms)
+{
+    m_now += (uint64_t)ms * 1000000;
+}
+
+void Ni4050Simulator::resetAdc()
+{
+    m_adcCommand = NI4050_ADC_COMMAND_DEFAULT;
+    m_adcByte = 0;
+    m_adcMode = 0;
+    m_adcChannel = 0;
+    m_filterHigh = NI4050_ADC_WRITE_FILTERHIGH_10HZ;
+    m_filterLow = NI4050_ADC_WRITE_FILTERLOW_10HZ;
+    m_zeroCal = 0;
+    m_fullCal = 0;
+    m_adcBusyUntil = 0;
+    m_running = false;
+    m_nextConversion = 0;
+    m_newData = false;
+    m_overflow = false;
+    m_data = NI4050_CONVERT_CODE_ZERO;
+}
+
+void Ni4050Simulator::adcWrite(unsigned char val)
+{
+    switch (m_adcCommand & 0x70) {
+    case NI4050_ADC_COMMAND_REGSEL_MODEREG:
+        m_adcMode = val;
+        if (val & NI4050_ADC_WRITE_FSYNCH) {
+            // the channel is latched while the filter is held in reset, the
+            // command byte of the following start carries FSYNCH in bit 0
+            m_adcChannel = m_adcCommand & 0x03;
+            m_running = false;
+        } else if ((val & 0xE0) == NI4050_ADC_WRITE_MODE_NORMAL) {
+            startConversions();
+        }
+        break;
+    case NI4050_ADC_COMMAND_REGSEL_FILTERHIGH:
+        m_filterHigh = val;
+        if (m_running)
+            startConversions();
+        break;
+    case NI4050_ADC_COMMAND_REGSEL_FILTERLOW:
+        m_filterLow = val;
+        if (m_running)
+            startConversions();
+        break;
+    // the coefficients are taken but not modelled, the simulated ADC is ideal
+    case NI4050_ADC_COMMAND_REGSEL_ZEROCALIB:
+        if (m_adcByte < 3)
+            m_zeroCal = ((m_zeroCal << 8) | val) & 0xFFFFFF;
+        m_adcByte++;
+        break;
+    case NI4050_ADC_COMMAND_REGSEL_FULLCALIB:
+        if (m_adcByte < 3)
+            m_fullCal = ((m_fullCal << 8) | val) & 0xFFFFFF;
+        m_adcByte++;
+        break;
+    }
+}
+
+void Ni4050Simulator::startConversions()
+{
+    m_running = true;
+    m_newData = false;
+    m_nextConversion = m_now + m_timing.settleConversions * period();
+}
+
+// Latch the conversions which completed until now, the last one wins
+void Ni4050Simulator::update()
+{
+    if (!m_running || m_now < m_nextConversion)
+        return;
+
+    uint64_t p = period();
+    uint64_t done = (m_now - m_nextConversion) / p + 1;
+
+    m_conversions += done;
+    m_nextConversion += done * p;
+    m_data = convert();
+    m_newData = true;
+}
+
+uint64_t Ni4050Simulator::period() const
+{
+    unsigned int code = ((m_filterHigh & 0x0F) << 8) | m_filterLow;
+
+    if (code < NI4050_FILTER_CODE_MIN)
+        code = NI4050_FILTER_CODE_MIN;
+    return (uint64_t)code * 1000000000ULL / 19200 + m_timing.conversionExtraNs;
+}
+
+unsigned int Ni4050Simulator::convert()
+{
+    NI4050_RANGES r = range();
+    double x = m_input;
+    double code;
+
+    m_overflow = false;
+    if (r == NI4050_RANGE_INVALID)
+        return NI4050_CONVERT_CODE_ZERO;
+
+    const MeasurementData *info = &measurmentInfo[r];
+    if (info->scaleFlags & NI4050_SCALE_EXTOHM) {
+        // inverse of the linearization in ni4050ConvertRaw()
+        double intResistance = getWord(m_eeprom, NI4050_EEPROM_AREA_LOAD | NI4050_EEPROM_INTERNAL_RESISTANCE);
+        x = x * intResistance / (intResistance + x);
+    }
+
+    code = NI4050_CONVERT_CODE_ZERO + x * info->scaleDen / info->scaleNum * NI4050_CONVERT_CODE_SPAN;
+    if (m_noise > 0)
+        code += gaussian() * m_noise;
+
+    if (code < 0 || code > 0xFFFFFF) {
+        m_overflow = true;
+        code = code < 0 ? 0 : 0xFFFFFF;
+    }
+
+    return (unsigned int)(code + 0.5);
+}
+
+double Ni4050Simulator::gaussian()
+{
+    double u[2];
+
+    for (int i = 0; i < 2; i++) {
+        // xorshift64*, reproducible from run to run
+        m_random ^= m_random >> 12;
+        m_random ^= m_random << 25;
+        m_random ^= m_random >> 27;
+        u[i] = ((m_random * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    return sqrt(-2 * log(u[0] + 1e-300)) * cos(2 * M_PI * u[1]);
+}
@@ -0,0 +1,126 @@
+#ifndef NI4050SIM_H
+#define NI4050SIM_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "../module/ni4050_core.h"
+
+// Register level model of a DAQCard-4050.
+//
+// It implements the register map of ni4050.h behind a struct ni4050_ops,
+// so the driver core runs against it unchanged. Time is virtual: every
+// port access costs Timing::ioLatencyNs, ni4050_ops::delay() and advance()
+// move the clock forward, and conversions complete at the rate the filter
+// registers ask for.
+class Ni4050Simulator
+{
+public:
+    struct Timing {
+        uint64_t ioLatencyNs;           // cost of one inb/outb
+        uint64_t adcBusyNs;             // ADC_RDY low after a write to the ADC
+        uint64_t conversionExtraNs;     // added to the 1/f conversion period
+        unsigned int settleConversions; // periods until the first result after a start
+    };
+
+    enum {
+        EepromSize = NI4050_EEPROM_SIZE
+    };
+
+    struct PortWrite {
+        unsigned int reg;
+        unsigned char val;
+    };
+
+    Ni4050Simulator();
+
+    // Point a core at this card
+    void attach(struct ni4050_core *core);
+
+    // What the card measures, in the units ni4050ConvertRaw() returns
+    void setInput(double value) { m_input = value; }
+    double input() const { return m_input; }
+    // Gaussian noise added to every conversion, in codes
+    void setNoise(double codes) { m_noise = codes; }
+
+    void setTiming(const Timing &timing) { m_timing = timing; }
+    const Timing &timing() const { return m_timing; }
+
+    // Virtual time in ns
+    uint64_t now() const { return m_now; }
+    void advance(uint64_t ns);
+    // Time the next conversion completes, UINT64_MAX if the ADC is stopped
+    uint64_t nextConversion() const;
+    // NEW_DATA while the driver enabled the conversion interrupt
+    bool interruptPending();
+    unsigned char command() const { return m_command; }
+
+    // Port writes in order, recorded only while enabled
+    void setWriteLog(bool enabled) { m_writeLogEnabled = enabled; m_writeLog.clear(); }
+    const std::vector<PortWrite> &writeLog() const { return m_writeLog; }
+
+    // EEPROM image, loadDefaultEeprom() fills the calibration areas
+    unsigned char *eeprom() { return m_eeprom; }
+    void loadDefaultEeprom(unsigned int intResistance = 1000000);
+
+    // Range the card is set up for, NI4050_RANGE_INVALID if none matches
+    NI4050_RANGES range() const;
+    // Coefficients the driver wrote to the ADC
+    unsigned int zeroCalibration() const { return m_zeroCal; }
+    unsigned int fullCalibration() const { return m_fullCal; }
+    // Whether they are the words of the EEPROM block of range and a
+    // NI4050_FILTER_* preset, the block is located without the core's tables
+    bool calibrationMatches(NI4050_RANGES range, unsigned int preset) const;
+    uint64_t ioCount() const { return m_ioCount; }
+    uint64_t conversions() const { return m_conversions; }
+
+    unsigned char inb(unsigned int reg);
+    void outb(unsigned char val, unsigned int reg);
+    void delay(unsigned int ms);
+
+private:
+    void resetAdc();
+    void adcWrite(unsigned char val);
+    void startConversions();
+    void update();
+    uint64_t period() const;
+    unsigned int convert();
+    double gaussian();
+
+    Timing m_timing;
+    uint64_t m_now;
+    uint64_t m_ioCount;
+    uint64_t m_conversions;
+    bool m_writeLogEnabled;
+    std::vector<PortWrite> m_writeLog;
+
+    double m_input;
+    double m_noise;
+    uint64_t m_random;
+
+    // card registers
+    unsigned char m_command;
+    unsigned char m_config;
+    unsigned int m_eepromAddress;
+    unsigned char m_eeprom[EepromSize];
+
+    // AD7714 like ADC behind ADC_COMMAND/ADC_WRITE
+    unsigned char m_adcCommand;
+    unsigned int m_adcByte;
+    unsigned char m_adcMode;
+    unsigned char m_adcChannel;
+    unsigned char m_filterHigh;
+    unsigned char m_filterLow;
+    unsigned int m_zeroCal;
+    unsigned int m_fullCal;
+    uint64_t m_adcBusyUntil;
+
+    bool m_running;
+    uint64_t m_nextConversion;
+    bool m_newData;
+    bool m_overflow;
+    unsigned int m_data;
+};
+
+#endif // NI4050SIM_H
@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# The driver core on top of a simulated DAQCard-4050
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = ni4050sim
+TEMPLATE = lib
+CONFIG += staticlib
+
+OBJECTS_DIR = build
+DESTDIR = lib
+
+QMAKE_CFLAGS += -std=gnu99
+
+
+SOURCES += ni4050sim.cpp \
+        ../module/ni4050_core.c
+
+HEADERS  += ni4050sim.h \
+        ../module/ni4050_core.h